@@ -0,0 +1,392 @@
+//
+// Parse/serialize throughput over generated corpora. Each row reports
+// MB/s of JSON text, documents/s, heap allocations per document and the
+// peak RSS reached above the starting point while the row ran.
+//
+//   istream   operator>> as in json.cpp: readJson() into a buffer, then parse
+//   buffer    JsonParser over a string, as json2.cpp's operator>> does
+//   arena     JsonDocument, all nodes from one monotonic arena
+//   indexed   the two-stage SIMD parser, still slower than buffer
+//   tape      JsonTape, reused across documents
+//   ostream   operator<< into an ostringstream
+//   string    writeJson() into a reused std::string
+//   parallel  writeJsonParallel() on one thread per core, single documents only
+//   cached    JsonWriteCache rewriting after an edit of the first element
+//   memcpy    copying the text, the floor for the two below
+//   validate  validateJson()
+//   minify    minifyJson() into a reused std::string
+//
+// bench [--quick] [corpus...]
+//
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "../json.h"
+#include "../jsonindex.h"
+#include "../jsonlines.h"
+#include "../jsonminify.h"
+#include "../jsoncache.h"
+#include "../jsonparallel.h"
+#include "../jsontape.h"
+
+using namespace std;
+
+//
+// Allocation counting: every heap allocation, including those of the
+// default memory resource, goes through these.
+//
+static atomic<uint64_t> allocations(0);
+
+void *operator new(size_t n)
+{
+    allocations.fetch_add(1, memory_order_relaxed);
+    if (void *p = malloc(n ? n : 1)) return p;
+    throw bad_alloc();
+}
+
+void *operator new(size_t n, align_val_t align)
+{
+    allocations.fetch_add(1, memory_order_relaxed);
+    size_t a = (size_t)align;
+    if (void *p = aligned_alloc(a, (n + a - 1) / a * a)) return p;
+    throw bad_alloc();
+}
+
+// out of line, so GCC doesn't pair an inlined free() with operator new
+[[gnu::noinline]] void operator delete(void *p) noexcept { free(p); }
+[[gnu::noinline]] void operator delete(void *p, size_t) noexcept { free(p); }
+[[gnu::noinline]] void operator delete(void *p, align_val_t) noexcept { free(p); }
+[[gnu::noinline]] void operator delete(void *p, size_t, align_val_t) noexcept { free(p); }
+
+//
+// Peak RSS. Linux lets a process reset its high-water mark through
+// clear_refs; elsewhere the lifetime peak from getrusage is all there is.
+//
+static long statusKb(const char *field)
+{
+    ifstream is("/proc/self/status");
+    string line;
+    size_t len = strlen(field);
+    while (getline(is, line)) {
+        if (line.compare(0, len, field) == 0) return atol(line.c_str() + len + 1);
+    }
+    return -1;
+}
+
+// Hands freed memory back first, so each row starts from what is live.
+static void resetPeak()
+{
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    ofstream("/proc/self/clear_refs") << "5";
+}
+
+static long peakKb()
+{
+    long kb = statusKb("VmHWM");
+    if (kb >= 0) return kb;
+
+    rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+//
+// CORPORA
+//
+struct Corpus
+{
+    string name;
+    vector<string> docs;    // one entry per document; NDJSON is one text
+    bool lines = false;
+
+    size_t bytes() const
+    {
+        size_t n = 0;
+        for (auto &doc : docs) n += doc.size();
+        return n;
+    }
+
+    size_t count() const { return lines ? (size_t)std::count(docs[0].begin(), docs[0].end(), '\n') : docs.size(); }
+};
+
+static mt19937_64 rng(12345);
+
+static string number()
+{
+    char buf[32];
+    switch (rng() % 4)
+    {
+    case 0: return to_string((int64_t)(rng() % 2000000) - 1000000);
+    case 1: return to_string(rng());
+    case 2: snprintf(buf, sizeof(buf), "%.17g", (double)(rng() % 100000000) / 997.0); return buf;
+    default: snprintf(buf, sizeof(buf), "%.6e", ldexp((double)(rng() % 1000000), (int)(rng() % 200) - 100)); return buf;
+    }
+}
+
+static string text(size_t len)
+{
+    static const char *pieces[] = {"plain ", "word ", "\\\"quoted\\\" ", "tab\\t", "line\\n", "back\\\\slash ", "\\u00e9t\\u00e9 ", "caf\xc3\xa9 ", "\\ud83d\\ude00 ", "\\/ "};
+    string s;
+    while (s.size() < len) s += pieces[rng() % 10];
+    return s;
+}
+
+static string smallObject(uint64_t id)
+{
+    return "{\"id\":" + to_string(id) + ",\"name\":\"user" + to_string(rng() % 10000) + "\",\"active\":" + (rng() & 1 ? "true" : "false") +
+           ",\"score\":" + number() + ",\"tags\":[\"a\",\"bc\",\"def\"],\"geo\":{\"lat\":" + number() + ",\"lon\":" + number() + "}}";
+}
+
+static string nested(int depth)
+{
+    if (depth == 0) return number();
+    string inner = nested(depth - 1);
+    return (depth & 1) ? "{\"k\":" + inner + ",\"n\":" + number() + "}" : "[" + inner + "," + number() + "]";
+}
+
+static vector<Corpus> makeCorpora(double scale)
+{
+    vector<Corpus> all;
+    auto size = [&](size_t n) { return max<size_t>(1, (size_t)(n * scale)); };
+
+    Corpus numeric{"numeric", {"["}};
+    for (size_t n = 0; n < size(300000); n++) numeric.docs[0] += (n ? "," : "") + number();
+    numeric.docs[0] += "]";
+    all.push_back(std::move(numeric));
+
+    Corpus deep{"deep", {"["}};
+    for (size_t n = 0; n < size(400); n++) deep.docs[0] += (n ? "," : "") + nested(500);
+    deep.docs[0] += "]";
+    all.push_back(std::move(deep));
+
+    Corpus strings{"strings", {"["}};
+    for (size_t n = 0; n < size(40000); n++) strings.docs[0] += string(n ? "," : "") + "\"" + text(16 + rng() % 128) + "\"";
+    strings.docs[0] += "]";
+    all.push_back(std::move(strings));
+
+    Corpus small{"small", {}};
+    for (size_t n = 0; n < size(50000); n++) small.docs.push_back(smallObject(n));
+    all.push_back(std::move(small));
+
+    Corpus lines{"ndjson", {""}, true};
+    for (size_t n = 0; n < size(100000); n++) lines.docs[0] += smallObject(n) + "\n";
+    all.push_back(std::move(lines));
+
+    return all;
+}
+
+//
+// MEASUREMENT
+//
+static double minSeconds = 0.5;
+
+struct Row
+{
+    const Corpus &corpus;
+    const char *op;
+    const char *variant;
+};
+
+// Runs f (one pass over the corpus) until minSeconds have passed.
+template <typename F>
+static void measure(const Row &row, size_t bytesPerPass, F &&f)
+{
+    resetPeak();
+    long baseKb = statusKb("VmRSS");
+    f();    // warm up; its peak counts, its time doesn't
+
+    uint64_t allocs = allocations.load();
+    size_t passes = 0;
+    auto start = chrono::steady_clock::now();
+    double secs;
+    do {
+        f();
+        passes++;
+        secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (secs < minSeconds || passes < 3);
+    allocs = allocations.load() - allocs;
+
+    double docs = (double)row.corpus.count() * passes;
+    printf("%-8s %-10s %-8s %9.1f %12.0f %10.2f %9.1f\n", row.corpus.name.c_str(), row.op, row.variant,
+           bytesPerPass * passes / secs / 1e6, docs / secs, allocs / docs, (peakKb() - baseKb) / 1024.0);
+    fflush(stdout);
+}
+
+static volatile size_t sink;
+
+static void benchDocuments(const Corpus &c)
+{
+    size_t bytes = c.bytes();
+
+    measure({c, "parse", "istream"}, bytes, [&] {
+        for (auto &doc : c.docs) {
+            istringstream is(doc);
+            string buf = readJson(is);
+            JsonValue val = parseJson(buf);
+            sink = (size_t)val.type;
+        }
+    });
+    measure({c, "parse", "buffer"}, bytes, [&] {
+        for (auto &doc : c.docs) sink = (size_t)JsonParser(doc).parse().type;
+    });
+    measure({c, "parse", "arena"}, bytes, [&] {
+        JsonDocument d;
+        for (auto &doc : c.docs) sink = (size_t)d.parse(doc).type;
+    });
+    measure({c, "parse", "indexed"}, bytes, [&] {
+        for (auto &doc : c.docs) sink = (size_t)parseJsonIndexed(doc).type;
+    });
+    measure({c, "parse", "tape"}, bytes, [&] {
+        static JsonTape tape;
+        for (auto &doc : c.docs) {
+            tape.parse(doc);
+            sink = tape.tape.size();
+        }
+    });
+
+    string out;
+    measure({c, "check", "memcpy"}, bytes, [&] {
+        for (auto &doc : c.docs) {
+            out.assign(doc);
+            sink = out.size();
+        }
+    });
+    measure({c, "check", "validate"}, bytes, [&] {
+        for (auto &doc : c.docs) sink = validateJson(doc);
+    });
+    measure({c, "check", "minify"}, bytes, [&] {
+        for (auto &doc : c.docs) {
+            out.clear();
+            minifyJson(doc, out);
+            sink = out.size();
+        }
+    });
+
+    vector<JsonValue> values;
+    for (auto &doc : c.docs) values.push_back(parseJson(doc));
+
+    out.clear();
+    for (auto &val : values) out += toJson(val);
+    size_t outBytes = out.size();
+
+    measure({c, "write", "ostream"}, outBytes, [&] {
+        for (auto &val : values) {
+            ostringstream os;
+            os << val;
+            sink = os.tellp();
+        }
+    });
+    measure({c, "write", "string"}, outBytes, [&] {
+        for (auto &val : values) {
+            out.clear();
+            writeJson(out, val);
+            sink = out.size();
+        }
+    });
+    if (values.size() == 1) {
+        JsonThreadPool pool;
+        measure({c, "write", "parallel"}, outBytes, [&] {
+            out.clear();
+            writeJsonParallel(out, values[0], pool);
+            sink = out.size();
+        });
+
+        JsonWriteCache cache;
+        JsonPath first("/0");
+        measure({c, "write", "cached"}, outBytes, [&] {
+            cache.edit(values[0], first);
+            out.clear();
+            cache.write(out, values[0]);
+            sink = out.size();
+        });
+    }
+
+    measure({c, "round", "istream"}, bytes + outBytes, [&] {
+        for (auto &doc : c.docs) {
+            istringstream is(doc);
+            string buf = readJson(is);
+            ostringstream os;
+            os << parseJson(buf);
+            sink = os.tellp();
+        }
+    });
+    measure({c, "round", "buffer"}, bytes + outBytes, [&] {
+        for (auto &doc : c.docs) {
+            out.clear();
+            writeJson(out, JsonParser(doc).parse());
+            sink = out.size();
+        }
+    });
+}
+
+static void benchLines(const Corpus &c)
+{
+    const string &text = c.docs[0];
+    unsigned threads = max(1u, thread::hardware_concurrency());
+
+    JsonThreadPool one(1);
+    measure({c, "parse", "lines/1"}, text.size(), [&] { sink = parseJsonLines(text, one).size(); });
+
+    if (threads > 1) {
+        JsonThreadPool all(threads);
+        static char name[32];
+        snprintf(name, sizeof(name), "lines/%u", threads);
+        measure({c, "parse", name}, text.size(), [&] { sink = parseJsonLines(text, all).size(); });
+    }
+
+    vector<JsonValue> values = parseJsonLines(text, one);
+    string out;
+    measure({c, "write", "string"}, text.size(), [&] {
+        out.clear();
+        for (auto &val : values) {
+            writeJson(out, val);
+            out.push_back('\n');
+        }
+        sink = out.size();
+    });
+}
+
+int main(int argc, char *argv[])
+{
+    double scale = 1.0;
+    vector<string> only;
+
+    for (int n = 1; n < argc; n++) {
+        if (strcmp(argv[n], "--quick") == 0) {
+            scale = 0.1;
+            minSeconds = 0.05;
+        } else {
+            only.push_back(argv[n]);
+        }
+    }
+
+    vector<Corpus> corpora = makeCorpora(scale);
+
+    printf("%-8s %-10s %-8s %9s %12s %10s %9s\n", "corpus", "op", "variant", "MB/s", "docs/s", "allocs/doc", "peak MB");
+    for (auto &c : corpora)
+    {
+        if (!only.empty() && std::find(only.begin(), only.end(), c.name) == only.end()) continue;
+        if (c.lines) benchLines(c);
+        else benchDocuments(c);
+    }
+    return 0;
+}
@@ -0,0 +1,56 @@
+//
+// Serialization cost vs. nesting depth and size. Leaves are spread over a
+// chain of nested arrays of the given depth. With reference-based
+// traversal the time per output byte must stay roughly flat as either
+// grows; copying subtrees on the way down would make it grow with depth.
+//
+#include <iostream>
+#include <chrono>
+#include <string>
+
+#include "../json.h"
+
+using namespace std;
+
+static JsonValue build(int depth, int leaves)
+{
+    int perLevel = leaves / depth;
+    JsonValue val = JsonValue::Array();
+
+    for (int d = 0; d < depth; d++)
+    {
+        JsonValue::Array arr;
+        arr.reserve(perLevel + 1);
+        for (int n = 0; n < perLevel; n++) arr.push_back(JsonValue::Object{{"id", n}, {"name", "leaf"}});
+        arr.push_back(std::move(val));
+        val = std::move(arr);
+    }
+    return val;
+}
+
+static void run(int depth, int leaves)
+{
+    JsonValue doc = build(depth, leaves);
+    string out;
+    size_t bytes = 0;
+
+    auto start = chrono::steady_clock::now();
+    for (int n = 0; n < 10; n++) {
+        out.clear();
+        writeJson(out, doc);
+        bytes += out.size();
+    }
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+
+    cout << depth << '\t' << leaves << '\t' << out.size() << '\t' << ns / bytes << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    cout << "depth\tleaves\tbytes\tns/byte" << endl;
+
+    for (int depth : {1, 10, 100, 1000, 10000}) run(depth, 100000);
+    for (int leaves : {10000, 100000, 1000000}) run(100, leaves);
+
+    return 0;
+}
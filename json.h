@@ -0,0 +1,1714 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_set>
+#include <initializer_list>
+#include <memory_resource>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <istream>
+#include <ostream>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+//
+// Tag of a JsonValue. Dispatch on a value is a single byte compare.
+//
+enum class JsonType : uint8_t
+{
+    Null,
+    Bool,
+    Int,
+    Uint,
+    Float,
+    String,
+    Array,
+    Object
+};
+
+inline const char *jsonTypeName(JsonType type)
+{
+    switch (type)
+    {
+    case JsonType::Null: return "null";
+    case JsonType::Bool: return "bool";
+    case JsonType::Int: return "int";
+    case JsonType::Uint: return "uint";
+    case JsonType::Float: return "float";
+    case JsonType::String: return "string";
+    case JsonType::Array: return "array";
+    case JsonType::Object: return "object";
+    }
+    return "unknown";
+}
+
+//
+// Optional instrumentation. Built with -DJSON_STATS, the parsers and
+// writers count into a per-thread JsonStats; without it every hook
+// compiles away and jsonStats() stays zero. Work done for a call on a
+// JsonThreadPool is counted on the caller's thread once it returns.
+//
+struct JsonStats
+{
+    uint64_t bytesParsed = 0;
+    uint64_t bytesWritten = 0;
+
+    // tokens by type
+    uint64_t objects = 0;
+    uint64_t arrays = 0;
+    uint64_t keys = 0;
+    uint64_t strings = 0;
+    uint64_t ints = 0;
+    uint64_t uints = 0;
+    uint64_t doubles = 0;
+    uint64_t bools = 0;
+    uint64_t nulls = 0;
+    uint32_t maxDepth = 0;
+
+    // DOM allocations from the default resource or a JsonDocument arena
+    uint64_t allocations = 0;
+    uint64_t bytesAllocated = 0;
+
+    // Parse time is split between scanning text, converting numbers and
+    // the handler (building the DOM).
+    uint64_t tokenizeNs = 0;
+    uint64_t numberNs = 0;
+    uint64_t buildNs = 0;
+    uint64_t writeNs = 0;
+
+    // For totals across threads.
+    void add(const JsonStats &other)
+    {
+        bytesParsed += other.bytesParsed;
+        bytesWritten += other.bytesWritten;
+        objects += other.objects;
+        arrays += other.arrays;
+        keys += other.keys;
+        strings += other.strings;
+        ints += other.ints;
+        uints += other.uints;
+        doubles += other.doubles;
+        bools += other.bools;
+        nulls += other.nulls;
+        maxDepth = std::max(maxDepth, other.maxDepth);
+        allocations += other.allocations;
+        bytesAllocated += other.bytesAllocated;
+        tokenizeNs += other.tokenizeNs;
+        numberNs += other.numberNs;
+        buildNs += other.buildNs;
+        writeNs += other.writeNs;
+    }
+};
+
+inline JsonStats &jsonStats()
+{
+    static thread_local JsonStats stats;
+    return stats;
+}
+
+#ifdef JSON_STATS
+
+// Charges elapsed time to one phase at a time: each switch bills the time
+// since the previous switch to the phase being left.
+struct JsonStatsClock
+{
+    enum Phase : uint8_t { Idle, Tokenize, Number, Build, Write };
+
+    Phase phase = Idle;
+    std::chrono::steady_clock::time_point last;
+
+    static JsonStatsClock &get()
+    {
+        static thread_local JsonStatsClock clock;
+        return clock;
+    }
+
+    Phase enter(Phase next)
+    {
+        auto now = std::chrono::steady_clock::now();
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count();
+        JsonStats &stats = jsonStats();
+
+        switch (phase)
+        {
+        case Tokenize: stats.tokenizeNs += ns; break;
+        case Number: stats.numberNs += ns; break;
+        case Build: stats.buildNs += ns; break;
+        case Write: stats.writeNs += ns; break;
+        case Idle: break;
+        }
+
+        Phase prev = phase;
+        phase = next;
+        last = now;
+        return prev;
+    }
+};
+
+// Stays in a phase for the lifetime of the scope.
+struct JsonStatsPhase
+{
+    JsonStatsClock::Phase prev;
+
+    explicit JsonStatsPhase(JsonStatsClock::Phase phase) : prev(JsonStatsClock::get().enter(phase)) {}
+    ~JsonStatsPhase() { JsonStatsClock::get().enter(prev); }
+};
+
+// Counts the allocations passing through to upstream.
+struct JsonStatsResource : public std::pmr::memory_resource
+{
+    std::pmr::memory_resource *upstream;
+
+    explicit JsonStatsResource(std::pmr::memory_resource *_upstream) : upstream(_upstream) {}
+
+    void *do_allocate(size_t bytes, size_t align) override
+    {
+        JsonStats &stats = jsonStats();
+        stats.allocations++;
+        stats.bytesAllocated += bytes;
+        return upstream->allocate(bytes, align);
+    }
+
+    void do_deallocate(void *p, size_t bytes, size_t align) override { upstream->deallocate(p, bytes, align); }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other || upstream->is_equal(other);
+    }
+};
+
+// The default resource is swapped for a counting wrapper around it, which
+// is never destroyed since DOMs may outlive any scope.
+inline std::pmr::memory_resource *jsonStatsResource(std::pmr::memory_resource *mr)
+{
+    static JsonStatsResource *tracked = new JsonStatsResource(std::pmr::get_default_resource());
+    return mr == tracked->upstream ? tracked : mr;
+}
+
+#define JSON_STATS_ONLY(...) __VA_ARGS__
+#define JSON_STATS_PHASE(phase) JsonStatsPhase jsonStatsPhase(JsonStatsClock::phase)
+#else
+#define JSON_STATS_ONLY(...)
+#define JSON_STATS_PHASE(phase)
+#endif
+
+//
+// Appends str to out with JSON escaping. Runs of bytes that need no
+// escaping are appended in bulk; out needs append(const char *, size_t)
+// and push_back(char).
+//
+template <typename Sink>
+inline void escapeJson(Sink &out, std::string_view str)
+{
+    const char *p = str.data();
+    const char *end = p + str.size();
+    const char *run = p;
+
+    for (; p != end; p++)
+    {
+        unsigned char c = *p;
+        if (c >= ' ' && c != '\\' && c != '"' && c != 0x7F) continue;
+
+        out.append(run, p - run);
+        run = p + 1;
+
+        out.push_back('\\');
+        switch (c)
+        {
+        case '"':
+            out.push_back('"');
+            break;
+        case '\\':
+            out.push_back('\\');
+            break;
+        case '\t':
+            out.push_back('t');
+            break;
+        case '\r':
+            out.push_back('r');
+            break;
+        case '\n':
+            out.push_back('n');
+            break;
+        default:
+            char const *const hexdig = "0123456789ABCDEF";
+            char hex[5] = {'u', '0', '0', hexdig[c >> 4], hexdig[c & 0xF]};
+            out.append(hex, 5);
+        }
+    }
+    out.append(run, p - run);
+}
+
+//
+// Object key. Keys of up to 16 bytes are stored inline, longer ones are
+// allocated from a memory resource, and interned keys point into a
+// JsonKeyPool that must outlive them. Two keys interned in the same pool
+// compare equal by pointer.
+//
+struct JsonKey
+{
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+    JsonKey() : len(0), kind(Inline) {}
+
+    JsonKey(std::string_view key, const allocator_type &alloc = {}) { assign(key, alloc.resource()); }
+    JsonKey(const char *key, const allocator_type &alloc = {}) { assign(key, alloc.resource()); }
+
+    JsonKey(const JsonKey &other) : JsonKey(other, allocator_type()) {}
+
+    JsonKey(const JsonKey &other, const allocator_type &alloc)
+    {
+        if (other.kind == Interned) {
+            ext = other.ext;
+            len = other.len;
+            kind = Interned;
+        } else {
+            assign(other, alloc.resource());
+        }
+    }
+
+    JsonKey(JsonKey &&other) noexcept
+    {
+        steal(other);
+    }
+
+    JsonKey(JsonKey &&other, const allocator_type &alloc)
+    {
+        if (other.kind == Owned && !other.ext.mr->is_equal(*alloc.resource())) {
+            assign(other, alloc.resource());
+        } else {
+            steal(other);
+        }
+    }
+
+    ~JsonKey() { release(); }
+
+    JsonKey &operator=(const JsonKey &other)
+    {
+        if (this != &other) {
+            JsonKey tmp(other, kind == Owned ? ext.mr : std::pmr::get_default_resource());
+            release();
+            steal(tmp);
+        }
+        return *this;
+    }
+
+    JsonKey &operator=(JsonKey &&other) noexcept
+    {
+        if (this != &other) {
+            release();
+            steal(other);
+        }
+        return *this;
+    }
+
+    static JsonKey interned(std::string_view pooled)
+    {
+        JsonKey key;
+        key.ext.ptr = pooled.data();
+        key.ext.mr = nullptr;
+        key.len = (uint32_t)pooled.size();
+        key.kind = Interned;
+        return key;
+    }
+
+    const char *data() const { return kind == Inline ? small : ext.ptr; }
+    size_t size() const { return len; }
+    bool isInterned() const { return kind == Interned; }
+
+    std::string_view view() const { return std::string_view(data(), len); }
+    operator std::string_view() const { return view(); }
+
+    // Interned keys usually match on the pointer alone.
+    static bool same(std::string_view a, std::string_view b)
+    {
+        return a.size() == b.size() && (a.data() == b.data() || memcmp(a.data(), b.data(), a.size()) == 0);
+    }
+
+    friend bool operator==(const JsonKey &a, const JsonKey &b) { return same(a, b); }
+    friend bool operator==(const JsonKey &a, std::string_view b) { return same(a, b); }
+    friend bool operator==(const JsonKey &a, const char *b) { return same(a, b); }
+
+private:
+    enum Kind : uint8_t { Inline, Owned, Interned };
+
+    struct Ext
+    {
+        const char *ptr;
+        std::pmr::memory_resource *mr;
+    };
+
+    union {
+        char small[16];
+        Ext ext;
+    };
+    uint32_t len;
+    Kind kind;
+
+    void assign(std::string_view key, std::pmr::memory_resource *mr)
+    {
+        len = (uint32_t)key.size();
+        if (key.size() <= sizeof(small)) {
+            memcpy(small, key.data(), key.size());
+            kind = Inline;
+            return;
+        }
+        char *buf = (char *)mr->allocate(key.size(), 1);
+        memcpy(buf, key.data(), key.size());
+        ext.ptr = buf;
+        ext.mr = mr;
+        kind = Owned;
+    }
+
+    void steal(JsonKey &other)
+    {
+        memcpy((void *)this, (const void *)&other, sizeof(JsonKey));
+        other.len = 0;
+        other.kind = Inline;
+    }
+
+    void release()
+    {
+        if (kind == Owned) ext.mr->deallocate((void *)ext.ptr, len, 1);
+        len = 0;
+        kind = Inline;
+    }
+};
+
+//
+// Interning table for object keys. Each distinct key is stored once, for
+// the life of the pool. With concurrent set, lookups of keys already in
+// the pool only take a shared lock, so parsers on several threads can
+// share one pool.
+//
+struct JsonKeyPool
+{
+    explicit JsonKeyPool(bool _concurrent = true) : concurrent(_concurrent) {}
+
+    JsonKeyPool(const JsonKeyPool &) = delete;
+    JsonKeyPool &operator=(const JsonKeyPool &) = delete;
+
+    std::string_view intern(std::string_view key)
+    {
+        if (!concurrent) return insert(key);
+
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto it = keys.find(key);
+            if (it != keys.end()) return *it;
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        return insert(key);
+    }
+
+    size_t size() const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return keys.size();
+    }
+
+private:
+    bool concurrent;
+    mutable std::shared_mutex mutex;
+    std::pmr::monotonic_buffer_resource storage;
+    std::unordered_set<std::string_view> keys;
+
+    std::string_view insert(std::string_view key)
+    {
+        auto it = keys.find(key);
+        if (it != keys.end()) return *it;
+
+        char *buf = (char *)storage.allocate(key.size() + 1, 1);
+        memcpy(buf, key.data(), key.size());
+        buf[key.size()] = '\0';
+        return *keys.insert(std::string_view(buf, key.size())).first;
+    }
+};
+
+//
+// Object storage: members are kept contiguously in insertion order. While
+// the object is small, lookup is a linear scan; past hashThreshold members
+// an open-addressing index (slot -> member position + 1, 0 = empty) is
+// kept alongside, sized to at least twice the member count.
+//
+template <typename Value>
+struct JsonFlatMap
+{
+    using key_type = JsonKey;
+    using mapped_type = Value;
+    using value_type = std::pair<key_type, Value>;
+    using allocator_type = std::pmr::polymorphic_allocator<value_type>;
+    using iterator = typename std::pmr::vector<value_type>::iterator;
+    using const_iterator = typename std::pmr::vector<value_type>::const_iterator;
+
+    static constexpr size_t hashThreshold = 16;
+
+    JsonFlatMap() {}
+    JsonFlatMap(const allocator_type &alloc) : members(alloc), index(alloc) {}
+
+    JsonFlatMap(std::initializer_list<value_type> init, const allocator_type &alloc = {}) : members(alloc), index(alloc)
+    {
+        members.reserve(init.size());
+        for (auto &[key, val] : init) (*this)[key] = val;
+    }
+
+    JsonFlatMap(const JsonFlatMap &other) : members(other.members), index(other.index) {}
+    JsonFlatMap(const JsonFlatMap &other, const allocator_type &alloc) : members(other.members, alloc), index(other.index, alloc) {}
+    JsonFlatMap(JsonFlatMap &&other) noexcept : members(std::move(other.members)), index(std::move(other.index)) {}
+    JsonFlatMap(JsonFlatMap &&other, const allocator_type &alloc) : members(std::move(other.members), alloc), index(std::move(other.index), alloc) {}
+
+    JsonFlatMap &operator=(const JsonFlatMap &other) = default;
+    JsonFlatMap &operator=(JsonFlatMap &&other) = default;
+
+    allocator_type get_allocator() const { return members.get_allocator(); }
+
+    size_t size() const { return members.size(); }
+    bool empty() const { return members.empty(); }
+    void reserve(size_t n) { members.reserve(n); }
+
+    void clear()
+    {
+        members.clear();
+        index.clear();
+    }
+
+    iterator begin() { return members.begin(); }
+    iterator end() { return members.end(); }
+    const_iterator begin() const { return members.begin(); }
+    const_iterator end() const { return members.end(); }
+
+    iterator find(std::string_view key) { return members.begin() + findPos(key); }
+    const_iterator find(std::string_view key) const { return members.begin() + findPos(key); }
+    bool contains(std::string_view key) const { return findPos(key) != members.size(); }
+    size_t count(std::string_view key) const { return contains(key) ? 1 : 0; }
+
+    Value &at(std::string_view key)
+    {
+        size_t pos = findPos(key);
+        if (pos == members.size()) throw std::out_of_range("JSON key not found");
+        return members[pos].second;
+    }
+
+    const Value &at(std::string_view key) const
+    {
+        size_t pos = findPos(key);
+        if (pos == members.size()) throw std::out_of_range("JSON key not found");
+        return members[pos].second;
+    }
+
+    Value &operator[](std::string_view key)
+    {
+        size_t pos = findPos(key);
+        if (pos != members.size()) return members[pos].second;
+        append(key_type(key, get_allocator()), Value());
+        return members.back().second;
+    }
+
+    std::pair<iterator, bool> insert_or_assign(key_type &&key, Value &&val)
+    {
+        size_t pos = findPos(key);
+        if (pos != members.size()) {
+            members[pos].second = std::move(val);
+            return {members.begin() + pos, false};
+        }
+        append(std::move(key), std::move(val));
+        return {members.end() - 1, true};
+    }
+
+    size_t erase(std::string_view key)
+    {
+        size_t pos = findPos(key);
+        if (pos == members.size()) return 0;
+        members.erase(members.begin() + pos);
+        if (!index.empty()) rehash();
+        return 1;
+    }
+
+private:
+    std::pmr::vector<value_type> members;
+    std::pmr::vector<uint32_t> index;
+
+    static size_t hashKey(std::string_view key) { return std::hash<std::string_view>()(key); }
+
+    size_t findPos(std::string_view key) const
+    {
+        if (index.empty()) {
+            for (size_t pos = 0; pos < members.size(); pos++) {
+                if (JsonKey::same(members[pos].first, key)) return pos;
+            }
+            return members.size();
+        }
+
+        size_t mask = index.size() - 1;
+        for (size_t slot = hashKey(key) & mask; index[slot]; slot = (slot + 1) & mask) {
+            size_t pos = index[slot] - 1;
+            if (JsonKey::same(members[pos].first, key)) return pos;
+        }
+        return members.size();
+    }
+
+    void append(key_type &&key, Value &&val)
+    {
+        members.emplace_back(std::move(key), std::move(val));
+
+        if (members.size() <= hashThreshold) return;
+        if (members.size() * 2 > index.size()) {
+            rehash();
+            return;
+        }
+        place(members.size() - 1);
+    }
+
+    void place(size_t pos)
+    {
+        size_t mask = index.size() - 1;
+        size_t slot = hashKey(members[pos].first) & mask;
+        while (index[slot]) slot = (slot + 1) & mask;
+        index[slot] = (uint32_t)(pos + 1);
+    }
+
+    void rehash()
+    {
+        if (members.size() <= hashThreshold) {
+            index.clear();
+            return;
+        }
+
+        size_t slots = 64;
+        while (slots < members.size() * 4) slots *= 2;
+        index.assign(slots, 0);
+        for (size_t pos = 0; pos < members.size(); pos++) place(pos);
+    }
+};
+
+//
+// What JsonWriteCache (jsoncache.h) knows of a container from its last
+// write: where its text sits in the text of the container holding it.
+// Each text written gets a fresh version number, so a mark only counts
+// while the text around it is the version it names.
+//
+struct JsonTextMark
+{
+    uint64_t version = 0;       // of this container's text
+    uint64_t parentVersion = 0; // of the text holding it
+    size_t offset = 0;          // of this text within that one
+    size_t length = 0;
+    bool dirty = false;         // edited since it was written
+};
+
+//
+// An array or object node as JsonValue allocates it: the container plus
+// a slot for its JsonTextMark, which is allocated from the container's
+// resource and freed with it.
+//
+template <typename T>
+struct JsonNode : public T
+{
+    JsonTextMark *mark = nullptr;
+
+    template <typename... Args>
+        requires std::is_constructible_v<T, Args...>
+    JsonNode(Args &&...args) : T(std::forward<Args>(args)...) {}
+
+    ~JsonNode()
+    {
+        if (mark) std::pmr::polymorphic_allocator<>(this->get_allocator().resource()).delete_object(mark);
+    }
+};
+
+//
+// Discriminated union holding one JSON value. Scalars are stored inline,
+// strings/arrays/objects are owned through a pointer so the value stays
+// 16 bytes regardless of what it holds.
+//
+// Storage is std::pmr: a string/array/object node is allocated from the
+// memory resource of the container it wraps, and freed back to it, so a
+// whole document can live in one arena. Copies go to the default resource.
+//
+struct JsonValue
+{
+    using String = std::pmr::string;
+    using Array = std::pmr::vector<JsonValue>;
+    using Object = JsonFlatMap<JsonValue>;
+
+    JsonType type;
+    union {
+        bool b;
+        int64_t i;
+        uint64_t u;
+        double f;
+        String *s;
+        Array *a;
+        Object *o;
+    };
+
+    JsonValue() : type(JsonType::Null), i(0) {}
+    JsonValue(std::nullptr_t) : type(JsonType::Null), i(0) {}
+    JsonValue(bool _value) : type(JsonType::Bool), b(_value) {}
+
+    template <typename T>
+        requires(std::is_integral_v<T> && !std::is_same_v<T, bool> && (std::is_signed_v<T> || sizeof(T) < 8))
+    JsonValue(T _value) : type(JsonType::Int), i(static_cast<int64_t>(_value)) {}
+
+    template <typename T>
+        requires(std::is_integral_v<T> && std::is_unsigned_v<T> && sizeof(T) == 8)
+    JsonValue(T _value) : type(JsonType::Uint), u(static_cast<uint64_t>(_value)) {}
+
+    template <typename T>
+        requires std::is_floating_point_v<T>
+    JsonValue(T _value) : type(JsonType::Float), f(static_cast<double>(_value)) {}
+
+    // A float is widened through its shortest decimal form, so 3.14f is
+    // stored (and written back) as 3.14 rather than 3.140000104904175.
+    JsonValue(float _value) : type(JsonType::Float), f(widen(_value)) {}
+
+    JsonValue(const char *_value) : type(JsonType::String), s(create<String>(defaultResource(), _value)) {}
+    JsonValue(std::string_view _value) : type(JsonType::String), s(create<String>(defaultResource(), _value)) {}
+    JsonValue(const std::string &_value) : type(JsonType::String), s(create<String>(defaultResource(), _value)) {}
+    JsonValue(const String &_value) : type(JsonType::String), s(create<String>(defaultResource(), _value)) {}
+    JsonValue(String &&_value) : type(JsonType::String), s(create<String>(resourceOf(_value), std::move(_value))) {}
+    JsonValue(const Array &_value) : type(JsonType::Array), a(create<Array>(defaultResource(), _value)) {}
+    JsonValue(Array &&_value) : type(JsonType::Array), a(create<Array>(resourceOf(_value), std::move(_value))) {}
+    JsonValue(const Object &_value) : type(JsonType::Object), o(create<Object>(defaultResource(), _value)) {}
+    JsonValue(Object &&_value) : type(JsonType::Object), o(create<Object>(resourceOf(_value), std::move(_value))) {}
+
+    JsonValue(const JsonValue &other) : type(JsonType::Null), i(0) { copyFrom(other); }
+
+    JsonValue(JsonValue &&other) noexcept : type(other.type), i(other.i)
+    {
+        other.type = JsonType::Null;
+        other.i = 0;
+    }
+
+    ~JsonValue() { release(); }
+
+    JsonValue &operator=(const JsonValue &other)
+    {
+        if (this != &other) {
+            JsonValue tmp(other);
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    JsonValue &operator=(JsonValue &&other) noexcept
+    {
+        if (this != &other) {
+            release();
+            type = other.type;
+            i = other.i;
+            other.type = JsonType::Null;
+            other.i = 0;
+        }
+        return *this;
+    }
+
+    void swap(JsonValue &other) noexcept
+    {
+        std::swap(type, other.type);
+        std::swap(i, other.i);
+    }
+
+    bool isNull() const { return type == JsonType::Null; }
+    bool isBool() const { return type == JsonType::Bool; }
+    bool isInt() const { return type == JsonType::Int; }
+    bool isUint() const { return type == JsonType::Uint; }
+    bool isFloat() const { return type == JsonType::Float; }
+    bool isString() const { return type == JsonType::String; }
+    bool isArray() const { return type == JsonType::Array; }
+    bool isObject() const { return type == JsonType::Object; }
+
+    bool asBool() const { check(JsonType::Bool); return b; }
+    int64_t asInt() const { check(JsonType::Int); return i; }
+    uint64_t asUint() const { check(JsonType::Uint); return u; }
+    double asFloat() const { check(JsonType::Float); return f; }
+    const String &asString() const { check(JsonType::String); return *s; }
+    String &asString() { check(JsonType::String); return *s; }
+    const Array &asArray() const { check(JsonType::Array); return *a; }
+    Array &asArray() { check(JsonType::Array); return *a; }
+    const Object &asObject() const { check(JsonType::Object); return *o; }
+    Object &asObject() { check(JsonType::Object); return *o; }
+
+    const char *typeName() const { return jsonTypeName(type); }
+
+    static std::string escape(std::string_view str)
+    {
+        std::string s;
+        escapeJson(s, str);
+        return s;
+    }
+
+    static double widen(float v)
+    {
+        char buf[32];
+        double d = v;
+        auto res = std::to_chars(buf, buf + sizeof(buf), v);
+        std::from_chars(buf, res.ptr, d);
+        return d;
+    }
+
+    // The mark slot of an array or object node.
+    JsonTextMark *&textMark()
+    {
+        if (isArray()) return static_cast<JsonNode<Array> *>(a)->mark;
+        return static_cast<JsonNode<Object> *>(o)->mark;
+    }
+
+    static std::pmr::memory_resource *defaultResource() { return std::pmr::get_default_resource(); }
+
+    template <typename T>
+    static std::pmr::memory_resource *resourceOf(const T &container) { return container.get_allocator().resource(); }
+
+    // Arrays and objects are allocated as JsonNodes.
+    template <typename T>
+    using Node = std::conditional_t<std::is_same_v<T, String>, T, JsonNode<T>>;
+
+    // Allocates a node from mr; uses-allocator construction hands mr on
+    // to the container itself.
+    template <typename T, typename... Args>
+    static T *create(std::pmr::memory_resource *mr, Args &&...args)
+    {
+        return std::pmr::polymorphic_allocator<>(mr).new_object<Node<T>>(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    static void destroy(T *node)
+    {
+        std::pmr::polymorphic_allocator<>(resourceOf(*node)).delete_object(static_cast<Node<T> *>(node));
+    }
+
+private:
+    void check(JsonType t) const
+    {
+        if (type != t) throw std::runtime_error(std::string("Invalid JSON type: ") + typeName());
+    }
+
+    void copyFrom(const JsonValue &other)
+    {
+        switch (other.type)
+        {
+        case JsonType::String: s = create<String>(defaultResource(), *other.s); break;
+        case JsonType::Array: a = create<Array>(defaultResource(), *other.a); break;
+        case JsonType::Object: o = create<Object>(defaultResource(), *other.o); break;
+        default: i = other.i; break;
+        }
+        type = other.type;
+    }
+
+    void release()
+    {
+        switch (type)
+        {
+        case JsonType::String: destroy(s); break;
+        case JsonType::Array: destroy(a); break;
+        case JsonType::Object: destroy(o); break;
+        default: break;
+        }
+        type = JsonType::Null;
+        i = 0;
+    }
+};
+
+//
+// Serializer appending to a contiguous sink, std::string by default: see
+// escapeJson() for what a sink needs. Numbers are formatted with
+// to_chars, so nothing goes through iostreams or per-value temporaries.
+//
+template <typename Sink = std::string>
+struct JsonWriter
+{
+    Sink &out;
+
+    explicit JsonWriter(Sink &_out) : out(_out) {}
+
+    void write(const JsonValue &val)
+    {
+        switch (val.type)
+        {
+        case JsonType::Null:
+            writeRaw("null");
+            return;
+        case JsonType::Bool:
+            writeRaw(val.b ? "true" : "false");
+            return;
+        case JsonType::Int:
+            writeInt(val.i);
+            return;
+        case JsonType::Uint:
+            writeUint(val.u);
+            return;
+        case JsonType::Float:
+            writeDouble(val.f);
+            return;
+        case JsonType::String:
+            writeString(*val.s);
+            return;
+        case JsonType::Array:
+            write(*val.a);
+            return;
+        case JsonType::Object:
+            write(*val.o);
+            return;
+        }
+        throw std::runtime_error("Invalid JSON object");
+    }
+
+    void write(const JsonValue::Array &arr)
+    {
+        out.push_back('[');
+        for (size_t n = 0; n < arr.size(); n++)
+        {
+            if (n) out.push_back(',');
+            write(arr[n]);
+        }
+        out.push_back(']');
+    }
+
+    void write(const JsonValue::Object &obj)
+    {
+        bool first = true;
+
+        out.push_back('{');
+        for (auto &[key, val] : obj)
+        {
+            if (!first) out.push_back(',');
+            first = false;
+            writeString(key);
+            out.push_back(':');
+            write(val);
+        }
+        out.push_back('}');
+    }
+
+    void writeRaw(std::string_view str) { out.append(str.data(), str.size()); }
+
+    void writeString(std::string_view str)
+    {
+        out.push_back('"');
+        escapeJson(out, str);
+        out.push_back('"');
+    }
+
+    void writeInt(int64_t v)
+    {
+        char buf[24];
+        writeRaw(std::string_view(buf, std::to_chars(buf, buf + sizeof(buf), v).ptr - buf));
+    }
+
+    void writeUint(uint64_t v)
+    {
+        char buf[24];
+        writeRaw(std::string_view(buf, std::to_chars(buf, buf + sizeof(buf), v).ptr - buf));
+    }
+
+    // Shortest representation that parses back to exactly v (to_chars
+    // without a precision). Integral values keep a ".0" so they read back
+    // as Float; inf/nan have no JSON form and are written as null.
+    void writeDouble(double v)
+    {
+        if (!std::isfinite(v)) {
+            writeRaw("null");
+            return;
+        }
+
+        char buf[32];
+        char *last = std::to_chars(buf, buf + sizeof(buf) - 2, v).ptr;
+        if (std::find_if(buf, last, [](char c) { return c == '.' || c == 'e'; }) == last) {
+            *last++ = '.';
+            *last++ = '0';
+        }
+        writeRaw(std::string_view(buf, last - buf));
+    }
+
+    void writeFloat(float v)
+    {
+        if (!std::isfinite(v)) {
+            writeRaw("null");
+            return;
+        }
+
+        char buf[32];
+        char *last = std::to_chars(buf, buf + sizeof(buf) - 2, v).ptr;
+        if (std::find_if(buf, last, [](char c) { return c == '.' || c == 'e'; }) == last) {
+            *last++ = '.';
+            *last++ = '0';
+        }
+        writeRaw(std::string_view(buf, last - buf));
+    }
+};
+
+//
+// Sink collecting output in a buffer and handing it to an ostream in
+// large chunks.
+//
+struct JsonStreamSink
+{
+    std::ostream &os;
+    std::string buf;
+    size_t written = 0;
+
+    static constexpr size_t chunkSize = 1 << 16;
+
+    explicit JsonStreamSink(std::ostream &_os) : os(_os) { buf.reserve(chunkSize); }
+    ~JsonStreamSink() { flush(); }
+
+    void append(const char *str, size_t n)
+    {
+        buf.append(str, n);
+        if (buf.size() >= chunkSize) flush();
+    }
+
+    void push_back(char c)
+    {
+        buf.push_back(c);
+        if (buf.size() >= chunkSize) flush();
+    }
+
+    void flush()
+    {
+        os.write(buf.data(), buf.size());
+        written += buf.size();
+        buf.clear();
+    }
+};
+
+template <typename T>
+inline std::ostream &writeJsonStream(std::ostream &os, const T &val)
+{
+    JSON_STATS_PHASE(Write);
+    JsonStreamSink sink(os);
+    JsonWriter<JsonStreamSink>(sink).write(val);
+    JSON_STATS_ONLY(jsonStats().bytesWritten += sink.written + sink.buf.size());
+    return os;
+}
+
+template <typename T>
+inline void writeJsonString(std::string &out, const T &val)
+{
+    JSON_STATS_PHASE(Write);
+    JSON_STATS_ONLY(size_t start = out.size());
+    JsonWriter(out).write(val);
+    JSON_STATS_ONLY(jsonStats().bytesWritten += out.size() - start);
+}
+
+inline std::ostream &writeJson(std::ostream &os, const JsonValue &val) { return writeJsonStream(os, val); }
+inline std::ostream &writeJson(std::ostream &os, const JsonValue::Array &arr) { return writeJsonStream(os, arr); }
+inline std::ostream &writeJson(std::ostream &os, const JsonValue::Object &obj) { return writeJsonStream(os, obj); }
+
+inline void writeJson(std::string &out, const JsonValue &val) { writeJsonString(out, val); }
+inline void writeJson(std::string &out, const JsonValue::Array &arr) { writeJsonString(out, arr); }
+inline void writeJson(std::string &out, const JsonValue::Object &obj) { writeJsonString(out, obj); }
+
+inline std::string toJson(const JsonValue &val)
+{
+    std::string out;
+    writeJson(out, val);
+    return out;
+}
+
+inline std::ostream &operator<<(std::ostream &os, const JsonValue &val)
+{
+    return writeJson(os, val);
+}
+
+// One flat object, for shipping as metrics.
+inline std::string toJson(const JsonStats &stats)
+{
+    const std::pair<const char *, uint64_t> fields[] = {
+        {"bytesParsed", stats.bytesParsed}, {"bytesWritten", stats.bytesWritten},
+        {"objects", stats.objects}, {"arrays", stats.arrays}, {"keys", stats.keys}, {"strings", stats.strings},
+        {"ints", stats.ints}, {"uints", stats.uints}, {"doubles", stats.doubles}, {"bools", stats.bools}, {"nulls", stats.nulls},
+        {"maxDepth", stats.maxDepth}, {"allocations", stats.allocations}, {"bytesAllocated", stats.bytesAllocated},
+        {"tokenizeNs", stats.tokenizeNs}, {"numberNs", stats.numberNs}, {"buildNs", stats.buildNs}, {"writeNs", stats.writeNs}};
+
+    std::string out;
+    for (auto &[name, count] : fields) {
+        out += out.empty() ? "{\"" : ",\"";
+        out += name;
+        out += "\":";
+        out += std::to_string(count);
+    }
+    out += '}';
+    return out;
+}
+
+//
+// Tokenizer state shared by the parsers: a contiguous buffer walked with
+// raw pointers, plus string, number and literal decoding. The buffer must
+// outlive the scanner.
+//
+struct JsonScanner
+{
+    const char *begin;
+    const char *p;
+    const char *end;
+    std::string scratch;
+    size_t base = 0;    // offset of begin in the whole input, for errors
+    uint32_t depth = 0; // containers open, for the recursive readers
+
+    // The recursive readers use a stack frame per open container, so
+    // nesting is capped, at the same depth as the minifier's.
+    static constexpr uint32_t maxDepth = 1024;
+
+    JsonScanner(const char *data, size_t size) : begin(data), p(data), end(data + size) {}
+
+    [[noreturn]] void error(const char *what) const
+    {
+        throw std::runtime_error(std::string(what) + " at offset " + std::to_string(base + (p - begin)));
+    }
+
+    // Enters the container opening at p; the caller decrements depth
+    // when it closes.
+    void nest()
+    {
+        if (depth == maxDepth) error("JSON nesting too deep");
+        depth++;
+    }
+
+    static bool isSpace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+    static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+    void skipSpace()
+    {
+        while (p != end && isSpace(*p)) p++;
+    }
+
+    void finish()
+    {
+        skipSpace();
+        if (p != end) error("Invalid JSON trailing characters");
+    }
+
+    void expect(char c, const char *what)
+    {
+        skipSpace();
+        if (p == end || *p != c) error(what);
+        p++;
+    }
+
+    void literal(std::string_view word)
+    {
+        if ((size_t)(end - p) < word.size() || std::string_view(p, word.size()) != word) {
+            error("Invalid JSON token");
+        }
+        p += word.size();
+    }
+
+    // Decodes the string starting at the opening quote. A string without
+    // escapes is returned as a view into the input; otherwise it is
+    // decoded into scratch, with unescaped runs appended in bulk. Raw
+    // control characters are tolerated, as the istream parsers always did.
+    std::string_view parseString()
+    {
+        const char *start = ++p;
+
+        while (p != end && *p != '"' && *p != '\\') p++;
+        if (p == end) error("Unterminated JSON string");
+        if (*p == '"') return std::string_view(start, p++ - start);
+
+        scratch.assign(start, p - start);
+
+        while (1)
+        {
+            parseEscape(scratch);
+
+            const char *run = p;
+            while (p != end && *p != '"' && *p != '\\') p++;
+            scratch.append(run, p - run);
+
+            if (p == end) error("Unterminated JSON string");
+            if (*p == '"') {
+                p++;
+                return scratch;
+            }
+        }
+    }
+
+    // Decodes the escape sequence at p, a backslash, onto out.
+    void parseEscape(std::string &out)
+    {
+        p++;
+        if (p == end) error("Unterminated JSON string");
+        switch (*p++)
+        {
+        case '"': out += '"'; break;
+        case '\\': out += '\\'; break;
+        case '/': out += '/'; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'u': parseUnicode(out); break;
+        default:
+            p--;
+            error("Invalid JSON escape sequence");
+        }
+    }
+
+    uint32_t parseHex4()
+    {
+        if (end - p < 4) error("Invalid JSON unicode escape");
+        uint32_t cp = 0;
+        for (int n = 0; n < 4; n++, p++)
+        {
+            char c = *p;
+            cp <<= 4;
+            if (c >= '0' && c <= '9') cp |= c - '0';
+            else if (c >= 'a' && c <= 'f') cp |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') cp |= c - 'A' + 10;
+            else error("Invalid JSON unicode escape");
+        }
+        return cp;
+    }
+
+    void parseUnicode(std::string &out)
+    {
+        uint32_t cp = parseHex4();
+
+        // surrogate pair
+        if (cp >= 0xD800 && cp <= 0xDBFF) {
+            if (end - p < 2 || p[0] != '\\' || p[1] != 'u') error("Invalid JSON surrogate pair");
+            p += 2;
+            uint32_t lo = parseHex4();
+            if (lo < 0xDC00 || lo > 0xDFFF) error("Invalid JSON surrogate pair");
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+        } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+            error("Invalid JSON surrogate pair");
+        }
+
+        if (cp < 0x80) {
+            out += (char)cp;
+        } else if (cp < 0x800) {
+            out += (char)(0xC0 | (cp >> 6));
+            out += (char)(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += (char)(0xE0 | (cp >> 12));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        } else {
+            out += (char)(0xF0 | (cp >> 18));
+            out += (char)(0x80 | ((cp >> 12) & 0x3F));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+    }
+
+    // Rough base-10 magnitude of a validated number, used to tell
+    // overflow from underflow.
+    static long decimalExponent(const char *c, const char *last)
+    {
+        long mag = 0;
+        bool seen = false;
+
+        for (; c != last && isDigit(*c); c++) {
+            if (*c != '0') seen = true;
+            if (seen) mag++;
+        }
+        if (c != last && *c == '.') {
+            for (c++; c != last && isDigit(*c); c++) {
+                if (*c != '0') seen = true;
+                if (!seen) mag--;
+            }
+        }
+        if (c != last && (*c == 'e' || *c == 'E')) {
+            c++;
+            bool neg = (*c == '-');
+            if (*c == '+' || *c == '-') c++;
+            long e = 0;
+            for (; c != last; c++) {
+                if (e < 100000) e = e * 10 + (*c - '0');
+            }
+            mag += neg ? -e : e;
+        }
+        return mag;
+    }
+
+    //
+    // NUMERIC
+    //
+    // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    //
+    // Integers become Int, or Uint when they only fit unsigned; anything
+    // with a fraction/exponent, or too large for 64 bits, becomes Float.
+    // Digits are accumulated while scanning, so plain integers never go
+    // through a conversion routine; doubles use from_chars, which is
+    // exact and locale-independent.
+    //
+    template <typename Handler>
+    void parseNumber(Handler &handler)
+    {
+        JSON_STATS_PHASE(Number);
+        const char *start = p;
+        bool negative = false;
+
+        if (p != end && *p == '-') {
+            negative = true;
+            p++;
+        }
+
+        const char *digits = p;
+        uint64_t mantissa = 0;
+
+        if (p == end || !isDigit(*p)) error("Invalid JSON number");
+        if (*p == '0') {
+            p++;
+        } else {
+            while (p != end && isDigit(*p)) {
+                mantissa = mantissa * 10 + (*p - '0');
+                p++;
+            }
+        }
+        size_t ndigits = p - digits;
+
+        bool integral = true;
+        if (p != end && *p == '.') {
+            integral = false;
+            p++;
+            if (p == end || !isDigit(*p)) error("Invalid JSON number");
+            while (p != end && isDigit(*p)) p++;
+        }
+        if (p != end && (*p == 'e' || *p == 'E')) {
+            integral = false;
+            p++;
+            if (p != end && (*p == '+' || *p == '-')) p++;
+            if (p == end || !isDigit(*p)) error("Invalid JSON number");
+            while (p != end && isDigit(*p)) p++;
+        }
+        if (p != end && (isDigit(*p) || *p == '.' || *p == '+' || *p == '-' || *p == 'e' || *p == 'E')) {
+            error("Invalid JSON number");
+        }
+
+        // 19 digits always fit in uint64_t; 20 may, so let from_chars decide
+        if (integral && ndigits <= 19) {
+            if (!negative) {
+                if (mantissa <= (uint64_t)std::numeric_limits<int64_t>::max()) return handler.onInt((int64_t)mantissa);
+                return handler.onUint(mantissa);
+            }
+            if (mantissa <= (uint64_t)std::numeric_limits<int64_t>::max()) return handler.onInt(-(int64_t)mantissa);
+            if (mantissa == (uint64_t)std::numeric_limits<int64_t>::max() + 1) return handler.onInt(std::numeric_limits<int64_t>::min());
+        } else if (integral && !negative && ndigits == 20) {
+            uint64_t u;
+            auto [ptr, ec] = std::from_chars(digits, p, u);
+            if (ec == std::errc() && ptr == p) return handler.onUint(u);
+        }
+
+        double d;
+        auto [ptr, ec] = std::from_chars(start, p, d);
+        if (ptr != p || (ec != std::errc() && ec != std::errc::result_out_of_range)) {
+            p = start;
+            error("Invalid JSON number");
+        }
+        if (ec == std::errc::result_out_of_range) {
+            // from_chars leaves d untouched on overflow/underflow
+            d = decimalExponent(digits, p) < 0 ? 0.0 : std::numeric_limits<double>::infinity();
+            if (negative) d = -d;
+        }
+        handler.onDouble(d);
+    }
+};
+
+//
+// SAX handler with no-op events. Handlers are template parameters of the
+// readers, so every event is a direct, inlinable call; derive from this
+// and hide only the events you care about.
+//
+struct JsonSaxHandler
+{
+    void onStartObject() {}
+    void onKey(std::string_view) {}
+    void onEndObject() {}
+    void onStartArray() {}
+    void onEndArray() {}
+    void onString(std::string_view) {}
+    void onInt(int64_t) {}
+    void onUint(uint64_t) {}
+    void onDouble(double) {}
+    void onBool(bool) {}
+    void onNull() {}
+};
+
+#ifdef JSON_STATS
+//
+// Passes events through to handler, counting tokens and nesting depth and
+// billing the handler's time to the build phase.
+//
+template <typename Handler>
+struct JsonStatsHandler
+{
+    Handler &handler;
+    JsonStats &stats = jsonStats();
+    uint32_t depth = 0;
+
+    explicit JsonStatsHandler(Handler &_handler) : handler(_handler) {}
+
+    void open()
+    {
+        if (++depth > stats.maxDepth) stats.maxDepth = depth;
+    }
+
+    void onStartObject() { stats.objects++; open(); JSON_STATS_PHASE(Build); handler.onStartObject(); }
+    void onKey(std::string_view k) { stats.keys++; JSON_STATS_PHASE(Build); handler.onKey(k); }
+    void onEndObject() { depth--; JSON_STATS_PHASE(Build); handler.onEndObject(); }
+    void onStartArray() { stats.arrays++; open(); JSON_STATS_PHASE(Build); handler.onStartArray(); }
+    void onEndArray() { depth--; JSON_STATS_PHASE(Build); handler.onEndArray(); }
+    void onString(std::string_view s) { stats.strings++; JSON_STATS_PHASE(Build); handler.onString(s); }
+    void onInt(int64_t v) { stats.ints++; JSON_STATS_PHASE(Build); handler.onInt(v); }
+    void onUint(uint64_t v) { stats.uints++; JSON_STATS_PHASE(Build); handler.onUint(v); }
+    void onDouble(double v) { stats.doubles++; JSON_STATS_PHASE(Build); handler.onDouble(v); }
+    void onBool(bool v) { stats.bools++; JSON_STATS_PHASE(Build); handler.onBool(v); }
+    void onNull() { stats.nulls++; JSON_STATS_PHASE(Build); handler.onNull(); }
+};
+#endif
+
+// Runs a Reader over the input, counted when stats are enabled. A
+// scratch string, if given, is lent to the reader for decoding strings,
+// so its capacity carries over from run to run.
+template <template <typename> class Reader, typename Handler>
+inline void runJsonReader(const char *data, size_t size, Handler &handler, std::string *scratch = nullptr)
+{
+#ifdef JSON_STATS
+    JSON_STATS_PHASE(Tokenize);
+    jsonStats().bytesParsed += size;
+    JsonStatsHandler<Handler> counted(handler);
+    Reader<JsonStatsHandler<Handler>> reader(data, size, counted);
+#else
+    Reader<Handler> reader(data, size, handler);
+#endif
+    if (scratch) reader.scratch.swap(*scratch);
+    reader.parse();
+    if (scratch) reader.scratch.swap(*scratch);
+}
+
+//
+// Recursive descent event parser. Strings and keys are handed to the
+// handler as views that are only valid for the duration of the call.
+//
+template <typename Handler>
+struct JsonReader : public JsonScanner
+{
+    Handler &handler;
+
+    JsonReader(const char *data, size_t size, Handler &_handler) : JsonScanner(data, size), handler(_handler) {}
+    JsonReader(std::string_view json, Handler &_handler) : JsonReader(json.data(), json.size(), _handler) {}
+
+    void parse()
+    {
+        parseValue();
+        finish();
+    }
+
+    void parseValue()
+    {
+        skipSpace();
+        if (p == end) error("Unexpected end of JSON input");
+
+        switch (*p)
+        {
+        // OBJECT
+        case '{':
+            parseObject();
+            return;
+        // ARRAY
+        case '[':
+            parseArray();
+            return;
+        // STRING
+        case '"':
+            handler.onString(parseString());
+            return;
+        // BOOL/NULL
+        case 't':
+            literal("true");
+            handler.onBool(true);
+            return;
+        case 'f':
+            literal("false");
+            handler.onBool(false);
+            return;
+        case 'n':
+            literal("null");
+            handler.onNull();
+            return;
+        // NUMERIC
+        default:
+            parseNumber(handler);
+            return;
+        }
+    }
+
+    void parseObject()
+    {
+        nest();
+        p++;
+        handler.onStartObject();
+
+        skipSpace();
+        if (p != end && *p == '}') {
+            p++;
+            handler.onEndObject();
+            depth--;
+            return;
+        }
+
+        while (1)
+        {
+            //
+            // KEY
+            //
+            skipSpace();
+            if (p == end || *p != '"') error("Invalid JSON key sequence");
+            handler.onKey(parseString());
+            expect(':', "Invalid JSON key sequence");
+
+            //
+            // VALUE
+            //
+            parseValue();
+
+            skipSpace();
+            if (p == end) error("Unexpected end of JSON input");
+            if (*p == ',') {
+                p++;
+                continue;
+            }
+            if (*p == '}') {
+                p++;
+                handler.onEndObject();
+                depth--;
+                return;
+            }
+            error("Invalid JSON Object");
+        }
+    }
+
+    void parseArray()
+    {
+        nest();
+        p++;
+        handler.onStartArray();
+
+        skipSpace();
+        if (p != end && *p == ']') {
+            p++;
+            handler.onEndArray();
+            depth--;
+            return;
+        }
+
+        while (1)
+        {
+            parseValue();
+
+            skipSpace();
+            if (p == end) error("Unexpected end of JSON input");
+            if (*p == ',') {
+                p++;
+                continue;
+            }
+            if (*p == ']') {
+                p++;
+                handler.onEndArray();
+                depth--;
+                return;
+            }
+            error("Invalid JSON Array");
+        }
+    }
+};
+
+// Parses the one value at scan.p and moves scan.p past it, for callers
+// reading a value out of the middle of their input. Counted when stats
+// are enabled, like runJsonReader().
+template <typename Handler>
+inline void runJsonReaderAt(JsonScanner &scan, Handler &handler)
+{
+#ifdef JSON_STATS
+    JSON_STATS_PHASE(Tokenize);
+    JsonStatsHandler<Handler> counted(handler);
+    JsonReader<JsonStatsHandler<Handler>> reader(scan.begin, scan.end - scan.begin, counted);
+#else
+    JsonReader<Handler> reader(scan.begin, scan.end - scan.begin, handler);
+#endif
+    reader.p = scan.p;
+    reader.base = scan.base;
+    reader.parseValue();
+    JSON_STATS_ONLY(jsonStats().bytesParsed += reader.p - scan.p);
+    scan.p = reader.p;
+}
+
+template <typename Handler>
+inline void parseJsonSax(std::string_view json, Handler &handler)
+{
+    runJsonReader<JsonReader>(json.data(), json.size(), handler);
+}
+
+//
+// Handler building a JsonValue tree with every string, array and object
+// allocated from mr, and object keys interned in keys when one is given.
+// Open containers are tracked by pointer: a container cannot move while
+// it is open, since its parent only grows after it closes.
+//
+struct JsonDomBuilder
+{
+    std::pmr::memory_resource *mr;
+    JsonKeyPool *keys;
+    JsonValue root;
+    JsonKey key;
+    std::vector<JsonValue *> stack;
+
+    JsonDomBuilder(std::pmr::memory_resource *_mr = std::pmr::get_default_resource(), JsonKeyPool *_keys = nullptr)
+        : mr(JSON_STATS_ONLY(jsonStatsResource)(_mr)), keys(_keys) {}
+
+    JsonValue *add(JsonValue &&val)
+    {
+        if (stack.empty()) {
+            root = std::move(val);
+            return &root;
+        }
+
+        JsonValue *top = stack.back();
+        if (top->type == JsonType::Array) {
+            top->a->push_back(std::move(val));
+            return &top->a->back();
+        }
+        return &top->o->insert_or_assign(std::move(key), std::move(val)).first->second;
+    }
+
+    void onStartObject() { stack.push_back(add(JsonValue(JsonValue::Object(mr)))); }
+    void onKey(std::string_view k) { key = keys ? JsonKey::interned(keys->intern(k)) : JsonKey(k, mr); }
+    void onEndObject() { stack.pop_back(); }
+    void onStartArray() { stack.push_back(add(JsonValue(JsonValue::Array(mr)))); }
+    void onEndArray() { stack.pop_back(); }
+    void onString(std::string_view s) { add(JsonValue(JsonValue::String(s, mr))); }
+    void onInt(int64_t v) { add(JsonValue(v)); }
+    void onUint(uint64_t v) { add(JsonValue(v)); }
+    void onDouble(double v) { add(JsonValue(v)); }
+    void onBool(bool v) { add(JsonValue(v)); }
+    void onNull() { add(JsonValue()); }
+};
+
+//
+// DOM parser: one of the event readers feeding a JsonDomBuilder.
+//
+template <template <typename> class Reader>
+struct JsonBasicParser
+{
+    const char *data;
+    size_t size;
+    std::pmr::memory_resource *mr;
+    JsonKeyPool *keys;
+
+    JsonBasicParser(const char *_data, size_t _size, std::pmr::memory_resource *_mr = std::pmr::get_default_resource(), JsonKeyPool *_keys = nullptr)
+        : data(_data), size(_size), mr(_mr), keys(_keys) {}
+    JsonBasicParser(std::string_view json, std::pmr::memory_resource *_mr = std::pmr::get_default_resource(), JsonKeyPool *_keys = nullptr)
+        : JsonBasicParser(json.data(), json.size(), _mr, _keys) {}
+
+    JsonValue parse()
+    {
+        JsonDomBuilder builder(mr, keys);
+        runJsonReader<Reader>(data, size, builder);
+        return std::move(builder.root);
+    }
+
+    void parse(JsonValue::Object &obj)
+    {
+        JsonValue val = parse();
+        if (!val.isObject()) throw std::runtime_error("Invalid JSON Object");
+        obj = std::move(*val.o);
+    }
+
+    void parse(JsonValue::Array &arr)
+    {
+        JsonValue val = parse();
+        if (!val.isArray()) throw std::runtime_error("Invalid JSON Array");
+        arr = std::move(*val.a);
+    }
+};
+
+using JsonParser = JsonBasicParser<JsonReader>;
+
+inline JsonValue parseJson(const char *data, size_t size, std::pmr::memory_resource *mr = std::pmr::get_default_resource(), JsonKeyPool *keys = nullptr)
+{
+    return JsonParser(data, size, mr, keys).parse();
+}
+
+inline JsonValue parseJson(std::string_view json, std::pmr::memory_resource *mr = std::pmr::get_default_resource(), JsonKeyPool *keys = nullptr)
+{
+    return JsonParser(json, mr, keys).parse();
+}
+
+//
+// A parsed document whose nodes and strings all come from one monotonic
+// arena. Nothing is returned to malloc until the document is reparsed or
+// destroyed, when the arena is released in one go. Keys can be interned
+// in a pool shared by many documents.
+//
+struct JsonDocument
+{
+    std::pmr::monotonic_buffer_resource arena;
+#ifdef JSON_STATS
+    JsonStatsResource tracked{&arena};
+#endif
+    JsonKeyPool *keys = nullptr;
+    JsonValue root;
+
+    explicit JsonDocument(JsonKeyPool *_keys = nullptr) : keys(_keys) {}
+
+    explicit JsonDocument(std::string_view json, JsonKeyPool *_keys = nullptr) : arena(initialSize(json.size())), keys(_keys)
+    {
+        root = JsonParser(json, resource(), keys).parse();
+    }
+
+    JsonDocument(const JsonDocument &) = delete;
+    JsonDocument &operator=(const JsonDocument &) = delete;
+
+    JsonValue &parse(std::string_view json)
+    {
+        root = JsonValue();
+        arena.release();
+        root = JsonParser(json, resource(), keys).parse();
+        return root;
+    }
+
+    std::pmr::memory_resource *resource()
+    {
+#ifdef JSON_STATS
+        return &tracked;
+#else
+        return &arena;
+#endif
+    }
+
+    // The DOM is typically a small multiple of the text size.
+    static size_t initialSize(size_t n) { return n * 2 + 1024; }
+};
+
+// Reads the rest of the stream into one contiguous buffer for the parser.
+inline std::string readJson(std::istream &is)
+{
+    std::string buf;
+    char chunk[1 << 16];
+
+    while (is.read(chunk, sizeof(chunk)) || is.gcount()) {
+        buf.append(chunk, is.gcount());
+    }
+    is.clear(std::ios::eofbit);
+    return buf;
+}
+
+#endif
@@ -1,485 +1,201 @@
 #include <iostream>
-#include <typeinfo>
-#include <any>
-#include <map>
 #include <vector>
 #include <string>
 #include <sstream>
-#include <regex>
 #include <cctype>
 #include <cstring>
+#include <random>
+
+#include "json.h"
+#include "jsonindex.h"
+#include "jsonlines.h"
+#include "jsonlazy.h"
+#include "jsonbind.h"
+#include "jsonbinary.h"
+#include "jsontape.h"
+#include "jsonpush.h"
+#include "jsoncoro.h"
+#include "jsonminify.h"
+#include "jsonparallel.h"
+#include "jsoncache.h"
 
 using namespace std;
 
-struct JsonArray : public vector<any>
+struct JsonArray : public JsonValue::Array
 {
     JsonArray() {}
 
-    JsonArray(const vector<any>& arr) {
-        this->clear();
-        std::copy(arr.begin(), arr.end(), std::back_inserter(*this));
+    JsonArray(const JsonValue::Array& arr) : JsonValue::Array(arr) {}
+    JsonArray(JsonValue::Array&& arr) noexcept : JsonValue::Array(std::move(arr)) {}
+
+    JsonArray &operator=(const JsonValue::Array &arr)
+    {
+        JsonValue::Array::operator=(arr);
+        return *this;
     }
 
-    JsonArray &operator=(const vector<any> &arr)
+    JsonArray &operator=(JsonValue::Array &&arr)
     {
-        this->clear();
-        std::copy(arr.begin(), arr.end(), std::back_inserter(*this));
+        JsonValue::Array::operator=(std::move(arr));
         return *this;
     }
 
-    static const type_info &type() { return typeid(vector<any>); }
+    static JsonType type() { return JsonType::Array; }
 };
 
-struct JsonObject : public map<string,any>
+struct JsonObject : public JsonValue::Object
 {
     JsonObject() {}
 
-    JsonObject(const map<string,any>& map) {
-        this->clear();
-        this->insert(map.begin(), map.end());
+    JsonObject(const JsonValue::Object& map) : JsonValue::Object(map) {}
+    JsonObject(JsonValue::Object&& map) noexcept : JsonValue::Object(std::move(map)) {}
+
+    JsonObject &operator=(const JsonValue::Object &map)
+    {
+        JsonValue::Object::operator=(map);
+        return *this;
     }
 
-    JsonObject &operator=(const map<string, any> &map)
+    JsonObject &operator=(JsonValue::Object &&map)
     {
-        this->clear();
-        this->insert(map.begin(), map.end());
+        JsonValue::Object::operator=(std::move(map));
         return *this;
     }
 
-    static const type_info &type() { return typeid(map<string,any>); }
+    static JsonType type() { return JsonType::Object; }
 };
 
 struct JsonString : public string
 {
-    static const type_info &type() { return typeid(string); }
+    static JsonType type() { return JsonType::String; }
 
     static string escape(const std::string &str)
     {
-        std::string s = "";
-
-        for (char c : str)
-        {
-            if (' ' <= c && c <= '~' && c != '\\' && c != '"')
-            {
-                s += c;
-            }
-            else
-            {
-                s += '\\';
-                switch (c)
-                {
-                case '"':
-                    s += '"';
-                    break;
-                case '\\':
-                    s += '\\';
-                    break;
-                case '\t':
-                    s += 't';
-                    break;
-                case '\r':
-                    s += 'r';
-                    break;
-                case '\n':
-                    s += 'n';
-                    break;
-                default:
-                    char const *const hexdig = "0123456789ABCDEF";
-                    s += 'x';
-                    s += hexdig[c >> 4];
-                    s += hexdig[c & 0xF];
-                }
-            }
-        }
-
-        return s;
+        return JsonValue::escape(str);
     }
 
 };
 
 struct JsonInt
 {
-    static const type_info &type() { return typeid(int); }
+    static JsonType type() { return JsonType::Int; }
+};
+
+struct JsonUint
+{
+    static JsonType type() { return JsonType::Uint; }
 };
 
 struct JsonFloat
 {
-    static const type_info &type() { return typeid(float); }
+    static JsonType type() { return JsonType::Float; }
 };
 
 struct JsonBool
 {
-    static const type_info &type() { return typeid(bool); }
+    static JsonType type() { return JsonType::Bool; }
 };
 
 struct JsonNull
 {
-    static const type_info &type() { return typeid(nullptr); }
+    static JsonType type() { return JsonType::Null; }
 };
 
-ostream &operator<<(ostream&, JsonArray&);
-ostream &operator<<(ostream&, JsonObject&);
+ostream &operator<<(ostream&, const JsonArray&);
+ostream &operator<<(ostream&, const JsonObject&);
 
-ostream &operator<<(ostream &os, JsonObject &obj)
+ostream &operator<<(ostream &os, const JsonObject &obj)
 {
-    size_t count = 0;
-
-    os << "{";
-    for (auto &[key, val] : obj)
-    {
-        if (count) os << ",";
-        os << '"' << key << '"' << ':';
-
-        if (val.type() == JsonInt::type())
-        {
-            os << any_cast<int>(val);
-        }
-        else if (val.type() == JsonFloat::type())
-        {
-            os << any_cast<float>(val);
-        }
-        else if (val.type() == JsonBool::type())
-        {
-            bool tmp = any_cast<bool>(val);
-            if (tmp) os << "true";
-            else os << "false";
-        }
-        else if (val.type() == JsonString::type())
-        {
-            os << '"' << JsonString::escape(any_cast<string>(val)) << '"';
-        }
-        else if (val.type() == JsonArray::type())
-        {
-            JsonArray jarr(any_cast<vector<any>&>(val));
-            os << jarr;
-        }
-        else if (val.type() == typeid(JsonArray))
-        {
-            os << any_cast<JsonArray&>(val);
-        }
-        else if (val.type() == JsonObject::type())
-        {
-            JsonObject jobj(any_cast<map<string, any>&>(val));
-            os << jobj;
-        }
-        else if (val.type() == typeid(JsonObject))
-        {
-            os << any_cast<JsonObject&>(val);
-        }
-        else if (val.has_value() && val.type() == JsonNull::type()) {
-            os << "null";
-        }
-        else
-        {
-            cerr << "bad type: " << val.type().name() << endl;
-            throw runtime_error("Invalid JSON object");
-        }
-
-        count++;
-    }
-
-    os << "}";
-    return os;
+    return writeJson(os, obj);
 }
 
-ostream &operator<<(ostream &os, JsonArray &arr)
+ostream &operator<<(ostream &os, const JsonArray &arr)
 {
-    size_t count = 0;
-
-    os << "[";
-    for (auto &item : arr)
-    {
-        if (count) os << ",";
-
-        if (item.type() == JsonInt::type())
-        {
-            os << any_cast<int>(item);
-        }
-        else if (item.type() == JsonFloat::type())
-        {
-            os << any_cast<float>(item);
-        }
-        else if (item.type() == JsonBool::type())
-        {
-            bool tmp = any_cast<bool>(item);
-            if (tmp) os << "true";
-            else os << "false";
-        }
-        else if (item.type() == JsonString::type())
-        {
-            os << '"' << JsonString::escape(any_cast<string>(item)) << '"';
-        }
-        else if (item.type() == JsonArray::type())
-        {
-            JsonArray jarr(any_cast<vector<any>&>(item));
-            os << jarr;
-        }
-        else if (item.type() == typeid(JsonArray))
-        {
-            os << any_cast<JsonArray&>(item);
-        }
-        else if (item.type() == JsonObject::type())
-        {
-            JsonObject jobj(any_cast<map<string, any>&>(item));
-            os << jobj;
-        }
-        else if (item.type() == typeid(JsonObject))
-        {
-            os << any_cast<JsonObject&>(item);
-        }
-        else if (item.has_value() && item.type() == JsonNull::type())
-        {
-            os << "null";
-        }
-        else
-        {
-            cerr << "bad type: " << item.type().name() << endl;
-            throw runtime_error("Invalid JSON object");
-        }
-
-        count++;
-    }
-
-    os << "]";
-    return os;
+    return writeJson(os, arr);
 }
 
-istream &operator>>(istream&, JsonObject&);
-istream &operator>>(istream&, JsonArray&);
-
 istream &operator>>(istream &is, JsonObject &obj)
 {
-    char ch;
-    is >> ch;
-
-    if (ch != '{') throw runtime_error("Invalid JSON Object");
-
-    while (1)
-    {
-        string tok;
-        string key;
-
-        is >> ch;
-        if (ch == '}') break;
-        if (ch == ',') continue;
-        is.putback(ch);
-
-        //
-        // KEY
-        //
-        while (is.get(ch)) {
-            if (isspace(ch)) continue;
-            if (iscntrl(ch)) continue;
-            if (ch == '"') break;
-            cerr << '[' << ch << ']';
-            throw runtime_error("Invalid JSON key sequence");
-        }
-
-        if (ch != '"') {
-            cerr << '[' << ch << ']';
-            throw runtime_error("Invalid JSON key sequence");
-        }
-
-        while (is.get(ch) && ch != '"') key += ch;
-        while (is.get(ch) && ch != ':');
-
-        //
-        // VALUE
-        //
-        is >> ch;
-        
-        // ARRAY
-        if(ch == '[') {
-            is.putback(ch);
-            JsonArray arr;
-            is >> arr;
-            obj[key] = arr;
-            continue;
-        }
-        
-        // OBJECT
-        if(ch == '{') {
-            is.putback(ch);
-            JsonObject obj2;
-            is >> obj2;
-            obj[key] = obj2;
-            continue;
-        }
-
-        // STRING
-        if (ch == '"') {
-            while (is.get(ch)) {
-                if (ch == '\\') {
-                    tok += ch;
-                    is.get(ch);
-                    tok += ch;
-                    continue;
-                }
-                if (ch == '"') break;
-                tok += ch;
-            }
-
-            obj[key] = any_cast<string>(tok);
-            continue;
-        }
-        
-        // NUMERIC/BOOL/NULL
-        if (isdigit(ch) || ch == '+' || ch == '-') {
-            is.putback(ch);
-        } else if (ch == 't' || ch == 'f') {
-            is.putback(ch);
-        } else if (ch == 'n') {
-            is.putback(ch);
-        } else {
-            //noop
-        }
-
-        while(is.get(ch)) {
-            if (isspace(ch)) break;
-            if (ch == ',') break;
-            if (ch == '}') {
-                is.putback(ch);
-                break;
-            }
-            tok += ch;
-        }
-
-        if (tok == "true") {
-            obj[key] = any_cast<bool>(true);
-            continue;
-        }
-        if (tok == "false") {
-            obj[key] = any_cast<bool>(false);
-            continue;
-        }
-        if (tok == "null") {
-            obj[key] = nullptr;
-            continue;
-        }
-
-        if (regex_match(tok, regex("[(-|+)|][\\.0-9]+"))) {
-            if (strchr(tok.c_str(),'.')) {
-                obj[key] = any_cast<float>(strtof(tok.c_str(),0));
-            } else {
-                obj[key] = any_cast<int>(atoi(tok.c_str()));
-            }
-            continue;
-        }
-
-        // if we made it here, something is wrong
-        throw runtime_error("Invalid JSON token: " + tok);
-
-    } // while
-
+    string buf = readJson(is);
+    JsonParser(buf).parse(obj);
     return is;
 }
 
 istream &operator>>(istream &is, JsonArray &arr)
 {
-    char ch;
-    is >> ch;
-
-    if (ch != '[') throw runtime_error("Invalid JSON Array");
-
-    while (1)
-    {
-        string tok;
-
-        is >> ch;
-        if (ch == ']') break;
-        if (ch == ',') continue;
-
-        // ARRAY
-        if (ch == '[')
-        {
-            is.putback(ch);
-            JsonArray arr2;
-            is >> arr2;
-            arr.push_back(arr2);
-            continue;
-        }
-
-        // OBJECT
-        if(ch == '{') {
-            is.putback(ch);
-            JsonObject obj;
-            is >> obj;
-            arr.push_back(obj);
-            continue;
-        }
-
-        // STRING
-        if (ch == '"') {
-            while (is.get(ch)) {
-                if (ch == '\\') {
-                    tok += ch;
-                    is.get(ch);
-                    tok += ch;
-                    continue;
-                }
-                if (ch == '"') break;
-                tok += ch;
-            }
-
-            arr.push_back(any_cast<string>(tok));
-            continue;
-        }
-
-        // NUMERIC/BOOL/NULL
-        if (isdigit(ch) || ch == '+' || ch == '-') {
-            is.putback(ch);
-        } else if (ch == 't' || ch == 'f') {
-            is.putback(ch);
-        } else if (ch == 'n') {
-            is.putback(ch);
-        } else {
-            //noop
-        }
+    string buf = readJson(is);
+    JsonParser(buf).parse(arr);
+    return is;
+}
 
-        while(is.get(ch)) {
-            if (isspace(ch)) break;
-            if (ch == ',') break;
+struct NumberSum : public JsonSaxHandler
+{
+    double sum = 0;
 
-            if (ch == ']') {
-                is.putback(ch);
-                break;
-            }
-            tok += ch;
-        }
+    void onInt(int64_t v) { sum += v; }
+    void onUint(uint64_t v) { sum += v; }
+    void onDouble(double v) { sum += v; }
+};
 
-        if (tok == "true") {
-            arr.push_back(any_cast<bool>(true));
-            continue;
-        }
-        if (tok == "false") {
-            arr.push_back(any_cast<bool>(false));
-            continue;
-        }
-        if (tok == "null") {
-            arr.push_back(nullptr);
-            continue;
-        }
+struct Fill
+{
+    double px;
+    int64_t qty;
+};
+JSON_BIND(Fill, px, qty);
 
-        if (regex_match(tok, regex("[(-|+)|][\\.0-9]+"))) {
-            if (strchr(tok.c_str(),'.')) {
-                arr.push_back(any_cast<float>(strtof(tok.c_str(),0)));
-            } else {
-                arr.push_back(any_cast<int>(atoi(tok.c_str())));
-            }
-            continue;
-        }
+struct Order
+{
+    int64_t id;
+    double px;
+    std::string sym;
+    std::vector<Fill> fills;
+};
+JSON_BIND(Order, id, px, sym, fills);
 
-        // if we made it here, something is wrong
-        throw runtime_error("Invalid JSON token: " + tok);
+// True if f throws a runtime_error saying what.
+template <typename F>
+bool throws(F f, const char *what)
+{
+    try {
+        f();
+    } catch (const std::runtime_error &e) {
+        return strstr(e.what(), what) != nullptr;
+    }
+    return false;
+}
 
-    } // while
+// A document of every kind of value, with containers large enough to
+// split near the root and small ones below.
+JsonValue randomJson(mt19937 &rng, int depth)
+{
+    switch (rng() % (depth < 3 ? 8 : 5))
+    {
+    case 0: return JsonValue();
+    case 1: return JsonValue(rng() % 2 == 0);
+    case 2: return JsonValue((int64_t)rng() - (int64_t)(rng() % 1000000));
+    case 3: return JsonValue(ldexp((double)rng(), -(int)(rng() % 40)));
+    case 4: {
+        string str;
+        for (size_t n = rng() % 12; n--; ) str += "ab\"\\\n\x01 \xc3\xa9"[rng() % 10];
+        return JsonValue(str);
+    }
+    }
 
-    return is;
+    size_t size = rng() % (depth < 2 ? 200 : 8);
+    if (rng() % 2) {
+        JsonValue::Array arr;
+        for (size_t n = 0; n < size; n++) arr.push_back(randomJson(rng, depth + 1));
+        return JsonValue(std::move(arr));
+    }
+    JsonValue::Object obj;
+    for (size_t n = 0; n < size; n++) obj["k" + to_string(n)] = randomJson(rng, depth + 1);
+    return JsonValue(std::move(obj));
 }
 
 int main(int argc, char *argv[])
 {
-    map<string, any> m;
+    JsonValue::Object m;
     m["test1"] = 1;
     m["test2"] = string("hello\" \\ \x55 \'");
     m["test3"] = 3.14f;
@@ -490,7 +206,7 @@ int main(int argc, char *argv[])
     JsonObject jm1(m);
     cout << "JM1:" << jm1 << endl;
 
-    vector<any> v;
+    JsonValue::Array v;
     v.push_back(123);
     v.push_back(string("hello vec\n"));
     v.push_back(m);
@@ -503,6 +219,9 @@ int main(int argc, char *argv[])
     JsonObject jm2(m);
     cout << "JM2:" << jm2 << endl;
 
+    // every failed check below fails make check
+    int status = 0;
+
     JsonObject jm3;
     //string jsonString = R"({  "name":"John \"Smith", "age": 30, "isStudent": true, "scores": [90, 85, 95]})";
     //string jsonString = string("{ \n \"nullval\": null ,\n \"name\":\"Joh\042n\t \\\"Sm\x22ith\", \"age\": 30.81 , \"isStudent\": true, \"scores\"  : [ { \"k\":\"v\" }, [ 210 ] , 90 , 85, 95.7]}");
@@ -512,5 +231,105 @@ int main(int argc, char *argv[])
     ss >> jm3;
     cout << "GRAND FINALE:" << jm3 << endl;
 
-    return 0;
+    // object keys compare with string literals
+    bool keyed = jm3.begin()->first == "nullval" && jm3.begin()->first != "name";
+    cout << "KEY:" << jm3.begin()->first.view() << (keyed ? " (matches)" : " (differs)") << endl;
+    if (!keyed) status = 1;
+
+    JsonObject jm4;
+    JsonIndexParser(jsonString).parse(jm4);
+    cout << "INDEXED:" << jm4 << endl;
+
+    NumberSum sum;
+    parseJsonSax(jsonString, sum);
+    cout << "SAX SUM:" << sum.sum << endl;
+
+    JsonLazyValue lazy = parseJsonLazy(jsonString);
+    cout << "LAZY:" << lazy["name"].asString() << " " << lazy["scores"][1][0].asInt() << endl;
+
+    Order order = parseJsonAs<Order>(R"({"id":7,"sym":"XYZ","px":10.5,"fills":[{"px":10.5,"qty":100}]})");
+    cout << "TYPED:" << order.sym << " " << order.fills[0].qty << " " << toJson(order) << endl;
+
+    std::string packed = toMsgPack(JsonValue(jm3));
+    JsonObject jm5;
+    CborParser(toCbor(parseMsgPack(packed))).parse(jm5);
+    cout << "BINARY:" << packed.size() << " bytes " << jm5 << endl;
+
+    JsonTape tape = parseJsonTape(jsonString);
+    cout << "TAPE:" << tape.tape.size() << " entries, " << tape.root()["scores"].size() << " scores " << tape.root().get() << endl;
+
+    // as if read off a socket, 7 bytes at a time
+    auto pushed = JsonPushBuilder([](JsonValue &&val) { cout << "PUSH:" << val << endl; });
+    JsonPushParser push(pushed);
+    string stream = jsonString + " [1,2] \"three\"";
+    for (size_t n = 0; n < stream.size(); n += 7) push.feed(string_view(stream).substr(n, 7));
+    push.finish();
+
+    // nesting past the readers' cap is refused before the DOM gets deep
+    string deep = string(2000000, '[') + string(2000000, ']');
+    bool capped = throws([&] {
+        auto ignored = JsonPushBuilder([](JsonValue &&) {});
+        JsonPushParser deepPush(ignored);
+        deepPush.feed(deep);
+        deepPush.finish();
+    }, "JSON nesting too deep");
+    cout << "DEEP PUSH:" << (capped ? "rejected" : "accepted") << endl;
+    if (!capped) status = 1;
+
+    // the stream generators push-parse, so they inherit the cap
+    for (bool records : {false, true})
+    {
+        capped = throws([&] {
+            istringstream is(records ? deep : "[" + deep + "]");
+            for (JsonValue &val : records ? jsonRecords(is) : jsonElements(is)) (void)val;
+        }, "JSON nesting too deep");
+        cout << (records ? "DEEP RECORDS:" : "DEEP ELEMENTS:") << (capped ? "rejected" : "accepted") << endl;
+        if (!capped) status = 1;
+    }
+
+    string scoreText = R"([90, 85, {"k": "v"}, [210]])";
+    JsonValue scores = parseJson(scoreText);
+    for (JsonValue &val : jsonElements(scoreText)) cout << "ELEMENT:" << val << endl;
+    for (string_view chunk : jsonChunks(scores, 8)) cout << "CHUNK:" << chunk << endl;
+
+    // jsonString holds a raw tab inside a string, which RFC 8259 forbids
+    cout << "MINIFIED:" << minifyJson(R"( { "a" : [ 1, 2 ] , "b" : "c" } )") << " valid:" << validateJson(jsonString) << endl;
+
+    JsonThreadPool pool(4);
+    string lines = "{\"id\":1,\"tag\":\"a\"}\n\n[1,2,3]\r\n\"three\"\n{\"id\":4}";
+    for (auto &val : parseJsonLines(lines, pool)) cout << "NDJSON:" << val << endl;
+
+    // split into parts of 4 entries or more
+    string parallel;
+    writeJsonParallel(parallel, JsonValue(jm3), pool, 4);
+    bool same = parallel == toJson(JsonValue(jm3));
+    cout << "PARALLEL:" << parallel << (same ? " (same)" : " (differs)") << endl;
+    if (!same) status = 1;
+
+    mt19937 rng(2024);
+    for (int round = 0; round < 20; round++)
+    {
+        JsonValue random = randomJson(rng, 0);
+        string expected = toJson(random);
+        for (size_t minSplit : {1, 2, 7, 64})
+        {
+            string out;
+            writeJsonParallel(out, random, pool, minSplit);
+            if (out == expected) continue;
+            cout << "PARALLEL: random document " << round << " differs at minSplit " << minSplit << endl;
+            status = 1;
+        }
+    }
+
+    JsonValue state(jm3);
+    JsonWriteCache cache(1);
+    cache.write(cout << "CACHED:", state) << endl;
+    cache.edit(state, "/scores/1/0") = 211;
+    cache.write(cout << "CACHED:", state) << endl;
+
+#ifdef JSON_STATS
+    cout << "STATS:" << toJson(jsonStats()) << endl;
+#endif
+
+    return status;
 }
@@ -0,0 +1,616 @@
+#ifndef JSONBINARY_H
+#define JSONBINARY_H
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "json.h"
+
+//
+// Binary encodings of the same value model: MessagePack and CBOR (RFC
+// 8949). Writers take a JsonValue, Array or Object; readers report the
+// same SAX events as the text readers, so JsonDomBuilder, JsonBasicParser
+// and any custom handler work unchanged. Integers use the shortest
+// encoding, and doubles are stored as 32-bit floats when that is exact.
+//
+
+//
+// Bounds-checked big-endian reading shared by both decoders. The decoders
+// recurse once per open container (and CBOR tag), so nesting is capped at
+// maxDepth.
+//
+struct JsonBinaryScanner
+{
+    static constexpr uint32_t maxDepth = 1024;
+
+    const char *begin;
+    const char *p;
+    const char *end;
+    const char *format;
+    std::string scratch;
+    uint32_t depth = 0;
+
+    JsonBinaryScanner(const char *data, size_t size, const char *_format) : begin(data), p(data), end(data + size), format(_format) {}
+
+    [[noreturn]] void error(const char *what) const
+    {
+        throw std::runtime_error(std::string("Invalid ") + format + " " + what + " at offset " + std::to_string(p - begin));
+    }
+
+    void need(uint64_t n) const
+    {
+        if ((uint64_t)(end - p) < n) error("truncated input");
+    }
+
+    uint8_t byte()
+    {
+        need(1);
+        return (uint8_t)*p++;
+    }
+
+    uint64_t bigEndian(int n)
+    {
+        need(n);
+        uint64_t v = 0;
+        for (int k = 0; k < n; k++) v = (v << 8) | (uint8_t)*p++;
+        return v;
+    }
+
+    std::string_view bytes(uint64_t n)
+    {
+        need(n);
+        std::string_view s(p, n);
+        p += n;
+        return s;
+    }
+
+    void finish()
+    {
+        if (p != end) error("trailing bytes");
+    }
+
+    // Enters a level opened by the item at at; the caller decrements
+    // depth when it closes.
+    void nest(const char *at)
+    {
+        if (depth < maxDepth) {
+            depth++;
+            return;
+        }
+        p = at;
+        error("nesting depth");
+    }
+
+    static float toFloat(uint32_t bits)
+    {
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    static double toDouble(uint64_t bits)
+    {
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        return d;
+    }
+};
+
+// Appends v as n big-endian bytes.
+inline void putBigEndian(std::string &out, uint64_t v, int n)
+{
+    for (int k = n - 1; k >= 0; k--) out.push_back((char)(v >> (k * 8)));
+}
+
+// True when d survives a round trip through float. Converting a finite
+// double beyond float's range is undefined, so those are ruled out first.
+inline bool fitsFloat(double d)
+{
+    if (std::isfinite(d) && std::fabs(d) > std::numeric_limits<float>::max()) return false;
+    return (double)(float)d == d;
+}
+
+inline uint32_t floatBits(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+inline uint64_t doubleBits(double d)
+{
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    return bits;
+}
+
+//
+// MESSAGEPACK
+//
+struct MsgPackWriter
+{
+    std::string &out;
+
+    explicit MsgPackWriter(std::string &_out) : out(_out) {}
+
+    void write(const JsonValue &val)
+    {
+        switch (val.type)
+        {
+        case JsonType::Null: out.push_back((char)0xC0); return;
+        case JsonType::Bool: out.push_back((char)(val.b ? 0xC3 : 0xC2)); return;
+        case JsonType::Int: writeInt(val.i); return;
+        case JsonType::Uint: writeUint(val.u); return;
+        case JsonType::Float: writeDouble(val.f); return;
+        case JsonType::String: writeString(*val.s); return;
+        case JsonType::Array: write(*val.a); return;
+        case JsonType::Object: write(*val.o); return;
+        }
+        throw std::runtime_error("Invalid JSON object");
+    }
+
+    void write(const JsonValue::Array &arr)
+    {
+        writeHeader(arr.size(), 0x90, 15, 0xDC);
+        for (auto &val : arr) write(val);
+    }
+
+    void write(const JsonValue::Object &obj)
+    {
+        writeHeader(obj.size(), 0x80, 15, 0xDE);
+        for (auto &[key, val] : obj) {
+            writeString(key);
+            write(val);
+        }
+    }
+
+    void writeInt(int64_t v)
+    {
+        if (v >= 0) return writeUint((uint64_t)v);
+        if (v >= -32) {
+            out.push_back((char)v);
+        } else if (v >= INT8_MIN) {
+            out.push_back((char)0xD0);
+            putBigEndian(out, (uint64_t)v, 1);
+        } else if (v >= INT16_MIN) {
+            out.push_back((char)0xD1);
+            putBigEndian(out, (uint64_t)v, 2);
+        } else if (v >= INT32_MIN) {
+            out.push_back((char)0xD2);
+            putBigEndian(out, (uint64_t)v, 4);
+        } else {
+            out.push_back((char)0xD3);
+            putBigEndian(out, (uint64_t)v, 8);
+        }
+    }
+
+    void writeUint(uint64_t v)
+    {
+        if (v <= 0x7F) {
+            out.push_back((char)v);
+        } else if (v <= UINT8_MAX) {
+            out.push_back((char)0xCC);
+            putBigEndian(out, v, 1);
+        } else if (v <= UINT16_MAX) {
+            out.push_back((char)0xCD);
+            putBigEndian(out, v, 2);
+        } else if (v <= UINT32_MAX) {
+            out.push_back((char)0xCE);
+            putBigEndian(out, v, 4);
+        } else {
+            out.push_back((char)0xCF);
+            putBigEndian(out, v, 8);
+        }
+    }
+
+    void writeDouble(double v)
+    {
+        if (fitsFloat(v)) {
+            out.push_back((char)0xCA);
+            putBigEndian(out, floatBits((float)v), 4);
+        } else {
+            out.push_back((char)0xCB);
+            putBigEndian(out, doubleBits(v), 8);
+        }
+    }
+
+    void writeString(std::string_view str)
+    {
+        if (str.size() <= 31) {
+            out.push_back((char)(0xA0 | str.size()));
+        } else if (str.size() <= UINT8_MAX) {
+            out.push_back((char)0xD9);
+            putBigEndian(out, str.size(), 1);
+        } else {
+            writeHeader(str.size(), 0, 0, 0xDA);
+        }
+        out.append(str.data(), str.size());
+    }
+
+    // fix form up to fixMax, then the 16- and 32-bit forms at code, code + 1
+    void writeHeader(size_t n, uint8_t fix, size_t fixMax, uint8_t code)
+    {
+        if (n <= fixMax) {
+            out.push_back((char)(fix | n));
+        } else if (n <= UINT16_MAX) {
+            out.push_back((char)code);
+            putBigEndian(out, n, 2);
+        } else if (n <= UINT32_MAX) {
+            out.push_back((char)(code + 1));
+            putBigEndian(out, n, 4);
+        } else {
+            throw std::runtime_error("MessagePack container too large");
+        }
+    }
+};
+
+template <typename Handler>
+struct MsgPackReader : public JsonBinaryScanner
+{
+    Handler &handler;
+
+    MsgPackReader(const char *data, size_t size, Handler &_handler) : JsonBinaryScanner(data, size, "MessagePack"), handler(_handler) {}
+    MsgPackReader(std::string_view data, Handler &_handler) : MsgPackReader(data.data(), data.size(), _handler) {}
+
+    void parse()
+    {
+        parseValue();
+        finish();
+    }
+
+    void parseValue()
+    {
+        const char *start = p;
+        uint8_t c = byte();
+
+        if (c <= 0x7F) return handler.onInt(c);
+        if (c >= 0xE0) return handler.onInt((int8_t)c);
+        if ((c & 0xF0) == 0x80) return parseMap(c & 0x0F, start);
+        if ((c & 0xF0) == 0x90) return parseArray(c & 0x0F, start);
+        if ((c & 0xE0) == 0xA0) return handler.onString(bytes(c & 0x1F));
+
+        switch (c)
+        {
+        case 0xC0: return handler.onNull();
+        case 0xC2: return handler.onBool(false);
+        case 0xC3: return handler.onBool(true);
+        // bin is read as a string
+        case 0xC4: case 0xD9: return handler.onString(bytes(bigEndian(1)));
+        case 0xC5: case 0xDA: return handler.onString(bytes(bigEndian(2)));
+        case 0xC6: case 0xDB: return handler.onString(bytes(bigEndian(4)));
+        case 0xCA: return handler.onDouble(toFloat((uint32_t)bigEndian(4)));
+        case 0xCB: return handler.onDouble(toDouble(bigEndian(8)));
+        case 0xCC: return handler.onInt((int64_t)bigEndian(1));
+        case 0xCD: return handler.onInt((int64_t)bigEndian(2));
+        case 0xCE: return handler.onInt((int64_t)bigEndian(4));
+        case 0xCF: {
+            uint64_t u = bigEndian(8);
+            if (u <= (uint64_t)INT64_MAX) return handler.onInt((int64_t)u);
+            return handler.onUint(u);
+        }
+        case 0xD0: return handler.onInt((int8_t)bigEndian(1));
+        case 0xD1: return handler.onInt((int16_t)bigEndian(2));
+        case 0xD2: return handler.onInt((int32_t)bigEndian(4));
+        case 0xD3: return handler.onInt((int64_t)bigEndian(8));
+        case 0xDC: return parseArray(bigEndian(2), start);
+        case 0xDD: return parseArray(bigEndian(4), start);
+        case 0xDE: return parseMap(bigEndian(2), start);
+        case 0xDF: return parseMap(bigEndian(4), start);
+        }
+        p--;
+        error("type byte");
+    }
+
+    void parseArray(uint64_t n, const char *start)
+    {
+        nest(start);
+        handler.onStartArray();
+        while (n--) parseValue();
+        handler.onEndArray();
+        depth--;
+    }
+
+    void parseMap(uint64_t n, const char *start)
+    {
+        nest(start);
+        handler.onStartObject();
+        while (n--)
+        {
+            uint8_t c = byte();
+            if ((c & 0xE0) == 0xA0) handler.onKey(bytes(c & 0x1F));
+            else if (c == 0xD9) handler.onKey(bytes(bigEndian(1)));
+            else if (c == 0xDA) handler.onKey(bytes(bigEndian(2)));
+            else if (c == 0xDB) handler.onKey(bytes(bigEndian(4)));
+            else {
+                p--;
+                error("map key, expected string");
+            }
+            parseValue();
+        }
+        handler.onEndObject();
+        depth--;
+    }
+};
+
+//
+// CBOR
+//
+struct CborWriter
+{
+    std::string &out;
+
+    explicit CborWriter(std::string &_out) : out(_out) {}
+
+    void write(const JsonValue &val)
+    {
+        switch (val.type)
+        {
+        case JsonType::Null: out.push_back((char)0xF6); return;
+        case JsonType::Bool: out.push_back((char)(val.b ? 0xF5 : 0xF4)); return;
+        case JsonType::Int:
+            if (val.i >= 0) writeHead(0, (uint64_t)val.i);
+            else writeHead(1, ~(uint64_t)val.i);    // -1 - v
+            return;
+        case JsonType::Uint: writeHead(0, val.u); return;
+        case JsonType::Float: writeDouble(val.f); return;
+        case JsonType::String: writeString(*val.s); return;
+        case JsonType::Array: write(*val.a); return;
+        case JsonType::Object: write(*val.o); return;
+        }
+        throw std::runtime_error("Invalid JSON object");
+    }
+
+    void write(const JsonValue::Array &arr)
+    {
+        writeHead(4, arr.size());
+        for (auto &val : arr) write(val);
+    }
+
+    void write(const JsonValue::Object &obj)
+    {
+        writeHead(5, obj.size());
+        for (auto &[key, val] : obj) {
+            writeString(key);
+            write(val);
+        }
+    }
+
+    void writeDouble(double v)
+    {
+        if (fitsFloat(v)) {
+            out.push_back((char)0xFA);
+            putBigEndian(out, floatBits((float)v), 4);
+        } else {
+            out.push_back((char)0xFB);
+            putBigEndian(out, doubleBits(v), 8);
+        }
+    }
+
+    void writeString(std::string_view str)
+    {
+        writeHead(3, str.size());
+        out.append(str.data(), str.size());
+    }
+
+    void writeHead(uint8_t major, uint64_t v)
+    {
+        uint8_t m = major << 5;
+        if (v < 24) {
+            out.push_back((char)(m | v));
+        } else if (v <= UINT8_MAX) {
+            out.push_back((char)(m | 24));
+            putBigEndian(out, v, 1);
+        } else if (v <= UINT16_MAX) {
+            out.push_back((char)(m | 25));
+            putBigEndian(out, v, 2);
+        } else if (v <= UINT32_MAX) {
+            out.push_back((char)(m | 26));
+            putBigEndian(out, v, 4);
+        } else {
+            out.push_back((char)(m | 27));
+            putBigEndian(out, v, 8);
+        }
+    }
+};
+
+//
+// Definite and indefinite lengths, tags (ignored) and half floats are all
+// read; byte strings are read as strings and undefined as null.
+//
+template <typename Handler>
+struct CborReader : public JsonBinaryScanner
+{
+    Handler &handler;
+
+    CborReader(const char *data, size_t size, Handler &_handler) : JsonBinaryScanner(data, size, "CBOR"), handler(_handler) {}
+    CborReader(std::string_view data, Handler &_handler) : CborReader(data.data(), data.size(), _handler) {}
+
+    void parse()
+    {
+        parseValue();
+        finish();
+    }
+
+    // The argument following an initial byte; info 31 (indefinite
+    // length) is for the caller to handle.
+    uint64_t argument(uint8_t info)
+    {
+        if (info < 24) return info;
+        switch (info)
+        {
+        case 24: return bigEndian(1);
+        case 25: return bigEndian(2);
+        case 26: return bigEndian(4);
+        case 27: return bigEndian(8);
+        }
+        p--;
+        error("additional info");
+    }
+
+    bool atBreak()
+    {
+        need(1);
+        if ((uint8_t)*p != 0xFF) return false;
+        p++;
+        return true;
+    }
+
+    // A text or byte string, whose chunks are joined into scratch when
+    // the length is indefinite.
+    std::string_view parseString(uint8_t major, uint8_t info)
+    {
+        if (info != 31) return bytes(argument(info));
+
+        scratch.clear();
+        while (!atBreak())
+        {
+            uint8_t c = byte();
+            if ((c >> 5) != major || (c & 0x1F) == 31) {
+                p--;
+                error("string chunk");
+            }
+            std::string_view chunk = bytes(argument(c & 0x1F));
+            scratch.append(chunk.data(), chunk.size());
+        }
+        return scratch;
+    }
+
+    void parseValue()
+    {
+        const char *start = p;
+        uint8_t c = byte();
+        uint8_t major = c >> 5;
+        uint8_t info = c & 0x1F;
+
+        if (major == 7) return parseSimple(info);
+        if (major == 2 || major == 3) return handler.onString(parseString(major, info));
+
+        bool indefinite = (info == 31);
+        if (indefinite && major != 4 && major != 5) error("indefinite length");
+
+        uint64_t n = indefinite ? 0 : argument(info);
+        switch (major)
+        {
+        case 0:
+            if (n <= (uint64_t)INT64_MAX) return handler.onInt((int64_t)n);
+            return handler.onUint(n);
+        case 1:
+            if (n <= (uint64_t)INT64_MAX) return handler.onInt(-1 - (int64_t)n);
+            return handler.onDouble(-1.0 - (double)n);
+        case 4:
+            nest(start);
+            handler.onStartArray();
+            if (indefinite) {
+                while (!atBreak()) parseValue();
+            } else {
+                while (n--) parseValue();
+            }
+            handler.onEndArray();
+            depth--;
+            return;
+        case 5:
+            nest(start);
+            handler.onStartObject();
+            if (indefinite) {
+                while (!atBreak()) parseMember();
+            } else {
+                while (n--) parseMember();
+            }
+            handler.onEndObject();
+            depth--;
+            return;
+        case 6:
+            nest(start);
+            parseValue();
+            depth--;
+            return;
+        }
+    }
+
+    void parseMember()
+    {
+        uint8_t c = byte();
+        if ((c >> 5) != 3) {
+            p--;
+            error("map key, expected text string");
+        }
+        handler.onKey(parseString(3, c & 0x1F));
+        parseValue();
+    }
+
+    void parseSimple(uint8_t info)
+    {
+        switch (info)
+        {
+        case 20: return handler.onBool(false);
+        case 21: return handler.onBool(true);
+        case 22: case 23: return handler.onNull();
+        case 25: return handler.onDouble(halfToDouble((uint16_t)bigEndian(2)));
+        case 26: return handler.onDouble(toFloat((uint32_t)bigEndian(4)));
+        case 27: return handler.onDouble(toDouble(bigEndian(8)));
+        }
+        p--;
+        error("simple value");
+    }
+
+    static double halfToDouble(uint16_t h)
+    {
+        int exp = (h >> 10) & 0x1F;
+        int mant = h & 0x3FF;
+        double v;
+        if (exp == 0) v = std::ldexp(mant, -24);
+        else if (exp != 31) v = std::ldexp(mant + 1024, exp - 25);
+        else v = mant ? std::numeric_limits<double>::quiet_NaN() : std::numeric_limits<double>::infinity();
+        return (h & 0x8000) ? -v : v;
+    }
+};
+
+using MsgPackParser = JsonBasicParser<MsgPackReader>;
+using CborParser = JsonBasicParser<CborReader>;
+
+inline void writeMsgPack(std::string &out, const JsonValue &val) { MsgPackWriter(out).write(val); }
+inline void writeMsgPack(std::string &out, const JsonValue::Array &arr) { MsgPackWriter(out).write(arr); }
+inline void writeMsgPack(std::string &out, const JsonValue::Object &obj) { MsgPackWriter(out).write(obj); }
+
+inline void writeCbor(std::string &out, const JsonValue &val) { CborWriter(out).write(val); }
+inline void writeCbor(std::string &out, const JsonValue::Array &arr) { CborWriter(out).write(arr); }
+inline void writeCbor(std::string &out, const JsonValue::Object &obj) { CborWriter(out).write(obj); }
+
+inline std::string toMsgPack(const JsonValue &val)
+{
+    std::string out;
+    writeMsgPack(out, val);
+    return out;
+}
+
+inline std::string toCbor(const JsonValue &val)
+{
+    std::string out;
+    writeCbor(out, val);
+    return out;
+}
+
+template <typename Handler>
+inline void parseMsgPackSax(std::string_view data, Handler &handler)
+{
+    runJsonReader<MsgPackReader>(data.data(), data.size(), handler);
+}
+
+template <typename Handler>
+inline void parseCborSax(std::string_view data, Handler &handler)
+{
+    runJsonReader<CborReader>(data.data(), data.size(), handler);
+}
+
+inline JsonValue parseMsgPack(std::string_view data, std::pmr::memory_resource *mr = std::pmr::get_default_resource(), JsonKeyPool *keys = nullptr)
+{
+    return MsgPackParser(data, mr, keys).parse();
+}
+
+inline JsonValue parseCbor(std::string_view data, std::pmr::memory_resource *mr = std::pmr::get_default_resource(), JsonKeyPool *keys = nullptr)
+{
+    return CborParser(data, mr, keys).parse();
+}
+
+#endif
@@ -0,0 +1,390 @@
+#ifndef JSONBIND_H
+#define JSONBIND_H
+
+#include <array>
+#include <optional>
+#include <tuple>
+
+#include "json.h"
+#include "jsonlazy.h"
+
+//
+// Typed binding. JSON_BIND(Type, field, ...) lists the members of a
+// struct that map to JSON object members of the same name; bound types
+// are then read straight from text into the struct and written straight
+// from it, with no JsonValue in between. Member types may be bool,
+// integers, floating point, std::string, std::vector, std::optional,
+// other bound types, or JsonValue for parts without a fixed schema.
+//
+// Key lookup is a perfect hash found at compile time over the field
+// names: one hash of the key, one table probe and one compare. Unknown
+// members are skipped without being validated; absent ones keep their
+// default value.
+//
+
+template <typename T>
+struct JsonBinding;
+
+template <typename T>
+concept JsonBound = requires { JsonBinding<T>::fields; };
+
+template <typename Class, typename Member>
+struct JsonField
+{
+    std::string_view name;
+    Member Class::*ptr;
+};
+
+template <typename Class, typename Member>
+constexpr JsonField<Class, Member> jsonField(std::string_view name, Member Class::*ptr)
+{
+    return {name, ptr};
+}
+
+//
+// Perfect hash over a fixed set of names: FNV-1a with a seed, masked to a
+// power-of-two table. JsonKeyTable tries seeds, then larger tables,
+// until no two names share a slot.
+//
+struct JsonKeyHash
+{
+    uint32_t seed;
+    uint32_t size;
+
+    constexpr uint32_t slot(std::string_view key) const
+    {
+        uint32_t h = 2166136261u ^ seed;
+        for (char c : key) {
+            h ^= (unsigned char)c;
+            h *= 16777619u;
+        }
+        return (h ^ (h >> 15)) & (size - 1);
+    }
+};
+
+template <typename T>
+struct JsonKeyTable
+{
+    static constexpr size_t count = std::tuple_size_v<decltype(JsonBinding<T>::fields)>;
+
+    static constexpr std::array<std::string_view, count> names = std::apply(
+        [](const auto &...field) { return std::array<std::string_view, count>{field.name...}; }, JsonBinding<T>::fields);
+
+    static constexpr JsonKeyHash hash = [] {
+        for (uint32_t size = 4; size <= (1 << 16); size *= 2)
+        {
+            if (size < count * 2) continue;
+            for (uint32_t seed = 0; seed < 256; seed++)
+            {
+                JsonKeyHash h = {seed, size};
+                bool perfect = true;
+                for (size_t a = 0; a < count && perfect; a++) {
+                    for (size_t b = a + 1; b < count && perfect; b++) perfect = h.slot(names[a]) != h.slot(names[b]);
+                }
+                if (perfect) return h;
+            }
+        }
+        throw std::logic_error("duplicate JSON field names");
+    }();
+
+    // slot -> field index + 1, 0 for empty
+    static constexpr auto slots = [] {
+        std::array<uint16_t, hash.size> table = {};
+        for (size_t n = 0; n < count; n++) table[hash.slot(names[n])] = (uint16_t)(n + 1);
+        return table;
+    }();
+
+    // Field index of key, or -1.
+    static int find(std::string_view key)
+    {
+        int n = slots[hash.slot(key)] - 1;
+        return (n >= 0 && names[n] == key) ? n : -1;
+    }
+};
+
+//
+// Reads bound types directly from text, on top of JsonScanner.
+//
+struct JsonBindReader : public JsonScanner
+{
+    // parseNumber handler keeping the number as parsed
+    struct Number
+    {
+        JsonType type = JsonType::Null;
+        int64_t i = 0;
+        uint64_t u = 0;
+        double f = 0;
+
+        void onInt(int64_t v) { type = JsonType::Int; i = v; }
+        void onUint(uint64_t v) { type = JsonType::Uint; u = v; }
+        void onDouble(double v) { type = JsonType::Float; f = v; }
+    };
+
+    JsonBindReader(std::string_view json) : JsonScanner(json.data(), json.size()) {}
+
+    char peekValue()
+    {
+        skipSpace();
+        if (p == end) error("Unexpected end of JSON input");
+        return *p;
+    }
+
+    void read(bool &val)
+    {
+        if (peekValue() == 't') {
+            literal("true");
+            val = true;
+        } else if (*p == 'f') {
+            literal("false");
+            val = false;
+        } else {
+            error("Invalid JSON type, expected bool");
+        }
+    }
+
+    template <typename T>
+        requires(std::is_integral_v<T> && !std::is_same_v<T, bool>)
+    void read(T &val)
+    {
+        peekValue();
+        const char *start = p;
+        Number num;
+        parseNumber(num);
+
+        bool fits = false;
+        if (num.type == JsonType::Int) {
+            fits = std::in_range<T>(num.i);
+            val = (T)num.i;
+        } else if (num.type == JsonType::Uint) {
+            fits = std::in_range<T>(num.u);
+            val = (T)num.u;
+        }
+        if (!fits) {
+            p = start;
+            error("Invalid JSON integer for field type");
+        }
+    }
+
+    template <typename T>
+        requires std::is_floating_point_v<T>
+    void read(T &val)
+    {
+        peekValue();
+        Number num;
+        parseNumber(num);
+        switch (num.type)
+        {
+        case JsonType::Int: val = (T)num.i; break;
+        case JsonType::Uint: val = (T)num.u; break;
+        default: val = (T)num.f; break;
+        }
+    }
+
+    void read(std::string &val)
+    {
+        if (peekValue() != '"') error("Invalid JSON type, expected string");
+        val = parseString();
+    }
+
+    template <typename T>
+    void read(std::optional<T> &val)
+    {
+        if (peekValue() == 'n') {
+            literal("null");
+            val.reset();
+            return;
+        }
+        read(val.emplace());
+    }
+
+    template <typename T>
+    void read(std::vector<T> &val)
+    {
+        val.clear();
+        expect('[', "Invalid JSON type, expected array");
+        skipSpace();
+        if (p != end && *p == ']') {
+            p++;
+            return;
+        }
+
+        while (1)
+        {
+            // vector<bool> hands out proxies, not bool &
+            if constexpr (std::is_same_v<T, bool>) {
+                bool b;
+                read(b);
+                val.push_back(b);
+            } else {
+                read(val.emplace_back());
+            }
+
+            skipSpace();
+            if (p == end) error("Unexpected end of JSON input");
+            if (*p++ == ']') return;
+            if (p[-1] != ',') {
+                p--;
+                error("Invalid JSON Array");
+            }
+        }
+    }
+
+    void read(JsonValue &val)
+    {
+        peekValue();
+        JsonDomBuilder builder;
+        runJsonReaderAt(*this, builder);
+        val = std::move(builder.root);
+    }
+
+    template <JsonBound T>
+    void read(T &obj)
+    {
+        expect('{', "Invalid JSON type, expected object");
+        skipSpace();
+        if (p != end && *p == '}') {
+            p++;
+            return;
+        }
+
+        while (1)
+        {
+            skipSpace();
+            if (p == end || *p != '"') error("Invalid JSON key sequence");
+            int field = JsonKeyTable<T>::find(parseString());
+            expect(':', "Invalid JSON key sequence");
+
+            if (field < 0) {
+                peekValue();
+                JsonLazyValue::skipValue(*this);
+            } else {
+                readField(obj, field, std::make_index_sequence<JsonKeyTable<T>::count>());
+            }
+
+            skipSpace();
+            if (p == end) error("Unexpected end of JSON input");
+            if (*p++ == '}') return;
+            if (p[-1] != ',') {
+                p--;
+                error("Invalid JSON Object");
+            }
+        }
+    }
+
+    // Turns the runtime field index back into the member, as a chain of
+    // compares the compiler can lower to a jump table.
+    template <typename T, size_t... I>
+    void readField(T &obj, int field, std::index_sequence<I...>)
+    {
+        (void)((field == (int)I && (read(obj.*std::get<I>(JsonBinding<T>::fields).ptr), true)) || ...);
+    }
+};
+
+template <typename Sink>
+void writeBound(JsonWriter<Sink> &w, bool val) { w.writeRaw(val ? "true" : "false"); }
+
+template <typename Sink, typename T>
+    requires(std::is_integral_v<T> && !std::is_same_v<T, bool>)
+void writeBound(JsonWriter<Sink> &w, T val)
+{
+    if constexpr (std::is_signed_v<T>) w.writeInt(val);
+    else w.writeUint(val);
+}
+
+template <typename Sink, typename T>
+    requires std::is_floating_point_v<T>
+void writeBound(JsonWriter<Sink> &w, T val)
+{
+    if constexpr (std::is_same_v<T, float>) w.writeFloat(val);
+    else w.writeDouble(val);
+}
+
+template <typename Sink>
+void writeBound(JsonWriter<Sink> &w, const std::string &val) { w.writeString(val); }
+
+template <typename Sink>
+void writeBound(JsonWriter<Sink> &w, const JsonValue &val) { w.write(val); }
+
+template <typename Sink, typename T>
+void writeBound(JsonWriter<Sink> &w, const std::optional<T> &val)
+{
+    if (val) writeBound(w, *val);
+    else w.writeRaw("null");
+}
+
+template <typename Sink, typename T>
+void writeBound(JsonWriter<Sink> &w, const std::vector<T> &val)
+{
+    w.writeRaw("[");
+    for (size_t n = 0; n < val.size(); n++)
+    {
+        if (n) w.writeRaw(",");
+        writeBound(w, val[n]);
+    }
+    w.writeRaw("]");
+}
+
+// Field names are C++ identifiers, so they never need escaping.
+template <typename Sink, JsonBound T>
+void writeBound(JsonWriter<Sink> &w, const T &obj)
+{
+    bool first = true;
+
+    w.writeRaw("{");
+    std::apply([&](const auto &...field) {
+        ((w.writeRaw(first ? "\"" : ",\""), first = false, w.writeRaw(field.name), w.writeRaw("\":"), writeBound(w, obj.*field.ptr)), ...);
+    }, JsonBinding<T>::fields);
+    w.writeRaw("}");
+}
+
+template <JsonBound T>
+void parseJsonInto(std::string_view json, T &obj)
+{
+    JsonBindReader reader(json);
+    reader.read(obj);
+    reader.finish();
+}
+
+template <JsonBound T>
+T parseJsonAs(std::string_view json)
+{
+    T obj{};
+    parseJsonInto(json, obj);
+    return obj;
+}
+
+template <JsonBound T>
+void writeJson(std::string &out, const T &obj)
+{
+    JsonWriter<std::string> w(out);
+    writeBound(w, obj);
+}
+
+template <JsonBound T>
+std::string toJson(const T &obj)
+{
+    std::string out;
+    writeJson(out, obj);
+    return out;
+}
+
+//
+// JSON_BIND(Type, member, ...) at global scope, after Type and the types
+// of its members are complete.
+//
+#define JSON_BIND_PARENS ()
+#define JSON_BIND_EXPAND(...) JSON_BIND_EXPAND3(JSON_BIND_EXPAND3(JSON_BIND_EXPAND3(JSON_BIND_EXPAND3(__VA_ARGS__))))
+#define JSON_BIND_EXPAND3(...) JSON_BIND_EXPAND2(JSON_BIND_EXPAND2(JSON_BIND_EXPAND2(JSON_BIND_EXPAND2(__VA_ARGS__))))
+#define JSON_BIND_EXPAND2(...) JSON_BIND_EXPAND1(JSON_BIND_EXPAND1(JSON_BIND_EXPAND1(JSON_BIND_EXPAND1(__VA_ARGS__))))
+#define JSON_BIND_EXPAND1(...) __VA_ARGS__
+#define JSON_BIND_EACH(T, first, ...) jsonField(#first, &T::first), __VA_OPT__(JSON_BIND_AGAIN JSON_BIND_PARENS (T, __VA_ARGS__))
+#define JSON_BIND_AGAIN() JSON_BIND_EACH
+
+#define JSON_BIND(Type, ...)                                                                    \
+    template <>                                                                                 \
+    struct JsonBinding<Type>                                                                    \
+    {                                                                                           \
+        static constexpr auto fields = std::tuple{JSON_BIND_EXPAND(JSON_BIND_EACH(Type, __VA_ARGS__))}; \
+    }
+
+#endif
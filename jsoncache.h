@@ -0,0 +1,188 @@
+#ifndef JSONCACHE_H
+#define JSONCACHE_H
+
+#include <atomic>
+
+#include "json.h"
+#include "jsonpath.h"
+
+//
+// Serialization cache for documents that are written again and again
+// with small edits in between. The cache keeps the text of its last
+// write, and each array or object in it keeps a JsonTextMark saying where
+// its own text sits within its parent's. The next write copies the text
+// of every unchanged container from the old text instead of walking and
+// escaping the subtree. Marks live in the nodes, so a container that is
+// freed or replaced takes its mark with it, and a new one is written out.
+//
+// Edits go through edit(), which flags the containers on the path to the
+// edited value and drops everything under it; a rewrite then only walks
+// those. The DOM doesn't track changes itself, so any mutation the cache
+// is not told about leaves stale text behind: a reference from edit() is
+// good for changes until the next write. Containers writing fewer than
+// minSize bytes are cheap to redo and not marked.
+//
+// A write updates the marks of the document it writes, so it takes the
+// document non-const, and two caches must not write one document from
+// different threads at once.
+//
+struct JsonWriteCache
+{
+    size_t minSize;
+    std::string text;           // the last write
+    uint64_t textVersion = 0;
+
+    explicit JsonWriteCache(size_t _minSize = 64) : minSize(_minSize) {}
+
+    void write(std::string &out, JsonValue &val)
+    {
+        JSON_STATS_PHASE(Write);
+        size_t start = out.size();
+        JsonWriter<std::string> writer(out);
+        uint64_t version = nextVersion();
+        write(writer, val, {textVersion, 0, version, start});
+        text.assign(out, start);
+        textVersion = version;
+        JSON_STATS_ONLY(jsonStats().bytesWritten += out.size() - start);
+    }
+
+    std::ostream &write(std::ostream &os, JsonValue &val)
+    {
+        std::string out;
+        write(out, val);
+        return os.write(out.data(), out.size());
+    }
+
+    std::string toJson(JsonValue &val)
+    {
+        std::string out;
+        write(out, val);
+        return out;
+    }
+
+    //
+    // The value at path under root, for changing. Throws if there is no
+    // such value, or if the path has a wildcard.
+    //
+    JsonValue &edit(JsonValue &root, const JsonPath &path)
+    {
+        JsonValue *val = &root;
+        for (const JsonPath::Step &step : path.steps)
+        {
+            touch(*val);
+            val = child(*val, step);
+            if (!val) throw std::runtime_error("No JSON value at path");
+        }
+        invalidate(*val);
+        return *val;
+    }
+
+    JsonValue &edit(JsonValue &root, std::string_view path) { return edit(root, JsonPath(path)); }
+
+    // Drops the text of val and everything under it, but not of the
+    // containers holding it. Renumbering val's text orphans the marks
+    // below it, so this doesn't walk the subtree.
+    void invalidate(JsonValue &val)
+    {
+        if (!touch(val)) return;
+        JsonTextMark *mark = val.textMark();
+        if (mark) mark->version = nextVersion();
+    }
+
+    void clear()
+    {
+        text.clear();
+        textVersion = 0;
+    }
+
+private:
+    // Where a container's text was in the last write, and goes in this one.
+    struct Place
+    {
+        uint64_t oldVersion;    // of the old text around it, 0 if there was none
+        size_t oldStart;        // of that text in the old write
+        uint64_t newVersion;    // of the new text around it
+        size_t newStart;        // of that text in out
+    };
+
+    // Unique across caches, so a mark left by another cache never matches.
+    static uint64_t nextVersion()
+    {
+        static std::atomic<uint64_t> last{0};
+        return ++last;
+    }
+
+    // Flags a container as edited; false for a scalar.
+    static bool touch(JsonValue &val)
+    {
+        if (!val.isArray() && !val.isObject()) return false;
+        JsonTextMark *mark = val.textMark();
+        if (mark) mark->dirty = true;
+        return true;
+    }
+
+    static JsonValue *child(JsonValue &val, const JsonPath::Step &step)
+    {
+        if (step.kind == JsonPath::StepKind::Wildcard) throw std::runtime_error("JSON edit path must name a single value");
+
+        if (val.isObject() && step.kind != JsonPath::StepKind::Element) {
+            auto it = val.o->find(step.name);
+            return it == val.o->end() ? nullptr : &it->second;
+        }
+        if (val.isArray() && step.kind != JsonPath::StepKind::Member && step.index < val.a->size()) return &(*val.a)[step.index];
+        return nullptr;
+    }
+
+    void write(JsonWriter<std::string> &writer, JsonValue &val, const Place &place)
+    {
+        if (!val.isArray() && !val.isObject()) return writer.write(val);
+
+        std::string &out = writer.out;
+        size_t start = out.size();
+        JsonTextMark *&mark = val.textMark();
+        bool known = mark && place.oldVersion && mark->parentVersion == place.oldVersion;
+        size_t oldStart = known ? place.oldStart + mark->offset : 0;
+
+        if (known && !mark->dirty) {
+            out.append(text, oldStart, mark->length);
+            mark->parentVersion = place.newVersion;
+            mark->offset = start - place.newStart;
+            return;
+        }
+
+        // Children's marks are relative to this container's old text,
+        // which only counts if the container itself was found in it.
+        Place inner = {known ? mark->version : 0, oldStart, nextVersion(), start};
+        if (val.isArray()) {
+            out.push_back('[');
+            for (size_t k = 0; k < val.a->size(); k++)
+            {
+                if (k) out.push_back(',');
+                write(writer, (*val.a)[k], inner);
+            }
+            out.push_back(']');
+        } else {
+            bool first = true;
+            out.push_back('{');
+            for (auto &[key, member] : *val.o)
+            {
+                if (!first) out.push_back(',');
+                first = false;
+                writer.writeString(key);
+                out.push_back(':');
+                write(writer, member, inner);
+            }
+            out.push_back('}');
+        }
+
+        size_t length = out.size() - start;
+        if (!mark) {
+            if (length < minSize) return;
+            std::pmr::memory_resource *mr = val.isArray() ? JsonValue::resourceOf(*val.a) : JsonValue::resourceOf(*val.o);
+            mark = std::pmr::polymorphic_allocator<>(mr).new_object<JsonTextMark>();
+        }
+        *mark = {inner.newVersion, place.newVersion, start - place.newStart, length, false};
+    }
+};
+
+#endif
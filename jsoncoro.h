@@ -0,0 +1,317 @@
+#ifndef JSONCORO_H
+#define JSONCORO_H
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+
+#include "json.h"
+#include "jsonlines.h"
+#include "jsonpush.h"
+
+//
+// Lazy sequence produced by a coroutine. Nothing runs until the first
+// begin(); each increment resumes the coroutine up to its next co_yield.
+// A yielded value lives until the next increment and may be moved from.
+// An exception thrown by the coroutine surfaces from begin() or ++.
+//
+template <typename T>
+struct JsonGenerator
+{
+    struct promise_type
+    {
+        T *current = nullptr;
+        std::exception_ptr error;
+
+        JsonGenerator get_return_object() { return JsonGenerator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { error = std::current_exception(); }
+
+        // The operand of co_yield outlives the suspension, so a pointer to it will do.
+        std::suspend_always yield_value(T &val) noexcept
+        {
+            current = std::addressof(val);
+            return {};
+        }
+
+        std::suspend_always yield_value(T &&val) noexcept
+        {
+            current = std::addressof(val);
+            return {};
+        }
+
+        // generators only yield
+        template <typename U>
+        void await_transform(U &&) = delete;
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    struct Iterator
+    {
+        using value_type = std::remove_cv_t<T>;
+        using difference_type = std::ptrdiff_t;
+
+        Handle coro;
+
+        T &operator*() const { return *coro.promise().current; }
+        T *operator->() const { return coro.promise().current; }
+
+        Iterator &operator++()
+        {
+            advance(coro);
+            return *this;
+        }
+
+        void operator++(int) { ++*this; }
+
+        bool operator==(std::default_sentinel_t) const { return coro.done(); }
+    };
+
+    explicit JsonGenerator(Handle _coro) : coro(_coro) {}
+    JsonGenerator(JsonGenerator &&other) noexcept : coro(std::exchange(other.coro, {})) {}
+    JsonGenerator(const JsonGenerator &) = delete;
+    JsonGenerator &operator=(const JsonGenerator &) = delete;
+
+    ~JsonGenerator()
+    {
+        if (coro) coro.destroy();
+    }
+
+    Iterator begin()
+    {
+        advance(coro);
+        return Iterator{coro};
+    }
+
+    std::default_sentinel_t end() const { return {}; }
+
+private:
+    Handle coro;
+
+    static void advance(Handle coro)
+    {
+        coro.resume();
+        if (coro.promise().error) std::rethrow_exception(std::exchange(coro.promise().error, {}));
+    }
+};
+
+//
+// PARSING
+//
+
+// Elements of the top-level array in json, each parsed when reached. The
+// text must outlive the generator.
+inline JsonGenerator<JsonValue> jsonElements(std::string_view json, std::pmr::memory_resource *mr = std::pmr::get_default_resource(),
+                                             JsonKeyPool *keys = nullptr)
+{
+    JsonScanner scan(json.data(), json.size());
+    scan.expect('[', "Invalid JSON Array");
+    scan.skipSpace();
+
+    if (scan.p != scan.end && *scan.p == ']') {
+        scan.p++;
+    } else {
+        while (1)
+        {
+            JsonDomBuilder builder(mr, keys);
+            runJsonReaderAt(scan, builder);
+            co_yield std::move(builder.root);
+
+            scan.skipSpace();
+            if (scan.p == scan.end) scan.error("Unexpected end of JSON input");
+            if (*scan.p++ == ']') break;
+            if (scan.p[-1] != ',') {
+                scan.p--;
+                scan.error("Invalid JSON Array");
+            }
+        }
+    }
+    scan.finish();
+}
+
+// Records of JSON Lines text, each parsed when reached. Errors name the
+// offending line; the text must outlive the generator.
+inline JsonGenerator<JsonValue> jsonRecords(std::string_view input, std::pmr::memory_resource *mr = std::pmr::get_default_resource(),
+                                            JsonKeyPool *keys = nullptr)
+{
+    for (const JsonLine &line : splitJsonLines(input))
+    {
+        JsonValue val;
+        try {
+            val = JsonParser(line.text, mr, keys).parse();
+        } catch (const std::runtime_error &e) {
+            throw std::runtime_error("line " + std::to_string(line.line) + ": " + e.what());
+        }
+        co_yield std::move(val);
+    }
+}
+
+//
+// Push handler passing on the elements of one top-level array, for
+// jsonElements() over a stream.
+//
+template <typename F>
+struct JsonElementBuilder
+{
+    JsonPushBuilder<F> inner;
+    uint32_t depth = 0;
+    bool closed = false;
+
+    explicit JsonElementBuilder(F f, std::pmr::memory_resource *mr, JsonKeyPool *keys) : inner(std::move(f), mr, keys) {}
+
+    // A value outside the array.
+    void outside()
+    {
+        if (depth == 0) throw std::runtime_error(closed ? "Invalid JSON trailing characters" : "Invalid JSON Array");
+    }
+
+    void onStartArray()
+    {
+        if (depth++ == 0) {
+            if (closed) throw std::runtime_error("Invalid JSON trailing characters");
+            closed = true;
+            return;
+        }
+        inner.onStartArray();
+    }
+
+    void onEndArray()
+    {
+        if (--depth > 0) inner.onEndArray();
+    }
+
+    void onStartObject() { outside(); depth++; inner.onStartObject(); }
+    void onKey(std::string_view k) { inner.onKey(k); }
+    void onEndObject() { depth--; inner.onEndObject(); }
+    void onString(std::string_view s) { outside(); inner.onString(s); }
+    void onInt(int64_t v) { outside(); inner.onInt(v); }
+    void onUint(uint64_t v) { outside(); inner.onUint(v); }
+    void onDouble(double v) { outside(); inner.onDouble(v); }
+    void onBool(bool v) { outside(); inner.onBool(v); }
+    void onNull() { outside(); inner.onNull(); }
+};
+
+//
+// The same over a stream, read in chunks through a JsonPushParser so
+// that only the chunk and the value in progress are held in memory.
+// Values complete in a chunk are yielded before the next read. Nesting
+// is capped by the push parser, as parseJson caps it.
+//
+inline JsonGenerator<JsonValue> jsonElements(std::istream &is, std::pmr::memory_resource *mr = std::pmr::get_default_resource(),
+                                             JsonKeyPool *keys = nullptr)
+{
+    std::vector<JsonValue> ready;
+    JsonElementBuilder builder([&](JsonValue &&val) { ready.push_back(std::move(val)); }, mr, keys);
+    JsonPushParser push(builder);
+    std::string chunk(1 << 16, '\0');
+
+    while (is.read(chunk.data(), chunk.size()) || is.gcount())
+    {
+        push.feed(chunk.data(), is.gcount());
+        for (JsonValue &val : ready) co_yield std::move(val);
+        ready.clear();
+    }
+    is.clear(std::ios::eofbit);
+
+    push.finish();
+}
+
+// Whitespace-separated values, such as JSON Lines. Empty input holds no
+// records.
+inline JsonGenerator<JsonValue> jsonRecords(std::istream &is, std::pmr::memory_resource *mr = std::pmr::get_default_resource(),
+                                            JsonKeyPool *keys = nullptr)
+{
+    std::vector<JsonValue> ready;
+    JsonPushBuilder builder([&](JsonValue &&val) { ready.push_back(std::move(val)); }, mr, keys);
+    JsonPushParser push(builder);
+    std::string chunk(1 << 16, '\0');
+
+    while (is.read(chunk.data(), chunk.size()) || is.gcount())
+    {
+        push.feed(chunk.data(), is.gcount());
+        for (JsonValue &val : ready) co_yield std::move(val);
+        ready.clear();
+    }
+    is.clear(std::ios::eofbit);
+
+    if (push.values == 0 && push.idle()) co_return;
+    push.finish();
+    for (JsonValue &val : ready) co_yield std::move(val);
+}
+
+//
+// SERIALIZATION
+//
+// Writes a value in chunks of about chunkSize bytes, walking the tree
+// with an explicit stack so the coroutine can stop between any two
+// members. A chunk only runs over chunkSize by the last scalar written.
+// The output is the same as writeJson(); each chunk is a view that lives
+// until the next is requested. val must outlive the generator.
+//
+inline JsonGenerator<std::string_view> jsonChunks(const JsonValue &val, size_t chunkSize = 1 << 16)
+{
+    struct Frame
+    {
+        const JsonValue *container;
+        size_t n;
+    };
+
+    std::string buf;
+    buf.reserve(chunkSize + 64);
+    JsonWriter<std::string> writer(buf);
+    std::vector<Frame> stack;
+    const JsonValue *next = &val;
+
+    while (1)
+    {
+        if (next) {
+            if (next->isArray()) {
+                buf.push_back('[');
+                stack.push_back({next, 0});
+            } else if (next->isObject()) {
+                buf.push_back('{');
+                stack.push_back({next, 0});
+            } else {
+                writer.write(*next);
+            }
+            next = nullptr;
+        }
+
+        if (buf.size() >= chunkSize) {
+            co_yield std::string_view(buf);
+            buf.clear();
+        }
+        if (stack.empty()) break;
+
+        Frame &top = stack.back();
+        if (top.container->isArray()) {
+            const JsonValue::Array &arr = *top.container->a;
+            if (top.n == arr.size()) {
+                buf.push_back(']');
+                stack.pop_back();
+                continue;
+            }
+            if (top.n) buf.push_back(',');
+            next = &arr[top.n++];
+        } else {
+            const JsonValue::Object &obj = *top.container->o;
+            if (top.n == obj.size()) {
+                buf.push_back('}');
+                stack.pop_back();
+                continue;
+            }
+            if (top.n) buf.push_back(',');
+            auto &[key, member] = *(obj.begin() + top.n++);
+            writer.writeString(key);
+            buf.push_back(':');
+            next = &member;
+        }
+    }
+
+    if (!buf.empty()) co_yield std::string_view(buf);
+}
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef JSONFILE_H
+#define JSONFILE_H
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#include "json.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define JSON_FILE_MMAP 1
+#endif
+
+//
+// Read-only view of a whole file. On POSIX systems the file is mapped
+// rather than read, so the parser works straight from the page cache with
+// no second copy of the text; MADV_SEQUENTIAL lets the kernel read ahead
+// and drop pages behind the parser. Pipes, devices and other files
+// without a real size are read into a string, as is everything on other
+// systems.
+//
+struct JsonMappedFile
+{
+    explicit JsonMappedFile(const std::string &path)
+    {
+#ifdef JSON_FILE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) fail(path);
+
+        struct stat st;
+        if (::fstat(fd, &st) < 0) {
+            int err = errno;
+            ::close(fd);
+            errno = err;
+            fail(path);
+        }
+
+        if (!S_ISREG(st.st_mode)) {
+            readAll(fd, path);
+            ::close(fd);
+            return;
+        }
+
+        size = (size_t)st.st_size;
+        if (size) {
+            void *p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                int err = errno;
+                ::close(fd);
+                errno = err;
+                fail(path);
+            }
+            ::madvise(p, size, MADV_SEQUENTIAL);
+            data = (const char *)p;
+            mapped = true;
+        }
+        ::close(fd);
+#else
+        std::ifstream is(path, std::ios::binary);
+        if (!is) fail(path);
+        buf = readJson(is);
+        data = buf.data();
+        size = buf.size();
+#endif
+    }
+
+    ~JsonMappedFile()
+    {
+#ifdef JSON_FILE_MMAP
+        if (mapped) ::munmap((void *)data, size);
+#endif
+    }
+
+    JsonMappedFile(const JsonMappedFile &) = delete;
+    JsonMappedFile &operator=(const JsonMappedFile &) = delete;
+
+    std::string_view view() const { return std::string_view(data, size); }
+
+private:
+    const char *data = "";
+    size_t size = 0;
+    bool mapped = false;
+    std::string buf;
+
+    [[noreturn]] static void fail(const std::string &path)
+    {
+        throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+    }
+
+#ifdef JSON_FILE_MMAP
+    // Reads fd to its end, for files that can't be mapped.
+    void readAll(int fd, const std::string &path)
+    {
+        char chunk[1 << 16];
+        while (1)
+        {
+            ssize_t n = ::read(fd, chunk, sizeof(chunk));
+            if (n == 0) break;
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                int err = errno;
+                ::close(fd);
+                errno = err;
+                fail(path);
+            }
+            buf.append(chunk, n);
+        }
+        data = buf.data();
+        size = buf.size();
+    }
+#endif
+};
+
+//
+// Parses a file in place. The DOM copies everything it keeps, so the
+// mapping is released on return. To parse into a JsonDocument arena:
+// doc.parse(JsonMappedFile(path).view()).
+//
+inline JsonValue parseJsonFile(const std::string &path, std::pmr::memory_resource *mr = std::pmr::get_default_resource(), JsonKeyPool *keys = nullptr)
+{
+    JsonMappedFile file(path);
+    return JsonParser(file.view(), mr, keys).parse();
+}
+
+#endif
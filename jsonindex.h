@@ -0,0 +1,428 @@
+#ifndef JSONINDEX_H
+#define JSONINDEX_H
+
+#include <cstring>
+
+#include "json.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define JSON_INDEX_X86 1
+#endif
+
+//
+// Two-stage parsing. Stage 1 classifies the input 64 bytes at a time into
+// bitmasks (quotes, backslashes, structural characters, whitespace) using
+// the widest vector unit the CPU has, and records the offset of every
+// structural character, every opening quote and the first byte of every
+// number/literal. Stage 2 walks those offsets and builds the same DOM as
+// JsonParser, never looking at whitespace or at bytes inside strings
+// except to decode them.
+//
+// It is not faster than JsonParser yet. In bench, it runs at 0.8-0.95
+// times JsonParser's speed on every corpus, and is slowest on the deep
+// one (45 vs 50 MB/s). Building the index costs more than stage 2 saves,
+// because JsonReader already skips whitespace and string bytes cheaply.
+// Use JsonParser unless measurements on your own inputs say otherwise.
+//
+
+struct JsonBlockMasks
+{
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;
+    uint64_t space;
+};
+
+inline JsonBlockMasks classifyScalar(const char *in)
+{
+    JsonBlockMasks m = {0, 0, 0, 0};
+
+    for (int n = 0; n < 64; n++)
+    {
+        uint64_t bit = 1ULL << n;
+        switch (in[n])
+        {
+        case '"': m.quote |= bit; break;
+        case '\\': m.backslash |= bit; break;
+        case '{': case '}': case '[': case ']': case ':': case ',': m.op |= bit; break;
+        case ' ': case '\t': case '\n': case '\r': m.space |= bit; break;
+        }
+    }
+    return m;
+}
+
+#ifdef JSON_INDEX_X86
+// '[' and ']' differ from '{' and '}' only in bit 0x20, so OR-ing it in
+// folds the four brackets into two compares.
+__attribute__((target("sse4.2")))
+inline JsonBlockMasks classifySse42(const char *in)
+{
+    JsonBlockMasks m = {0, 0, 0, 0};
+
+    for (int n = 0; n < 64; n += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + n));
+        __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+
+        __m128i op = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+        __m128i space = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+
+        m.quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << n;
+        m.backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << n;
+        m.op |= (uint64_t)(uint16_t)_mm_movemask_epi8(op) << n;
+        m.space |= (uint64_t)(uint16_t)_mm_movemask_epi8(space) << n;
+    }
+    return m;
+}
+
+__attribute__((target("avx2")))
+inline JsonBlockMasks classifyAvx2(const char *in)
+{
+    JsonBlockMasks m = {0, 0, 0, 0};
+
+    for (int n = 0; n < 64; n += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(in + n));
+        __m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+
+        __m256i op = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))));
+        __m256i space = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+
+        m.quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))) << n;
+        m.backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << n;
+        m.op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(op) << n;
+        m.space |= (uint64_t)(uint32_t)_mm256_movemask_epi8(space) << n;
+    }
+    return m;
+}
+#endif
+
+using JsonClassifyFn = JsonBlockMasks (*)(const char *);
+
+// Picks the classifier once, on first use, from what the CPU reports.
+inline JsonClassifyFn jsonClassifier()
+{
+    static const JsonClassifyFn fn = []() -> JsonClassifyFn {
+#ifdef JSON_INDEX_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return classifyAvx2;
+        if (__builtin_cpu_supports("sse4.2")) return classifySse42;
+#endif
+        return classifyScalar;
+    }();
+    return fn;
+}
+
+struct JsonStructuralIndex
+{
+    std::vector<uint32_t> positions;
+
+    void build(const char *data, size_t size)
+    {
+        build(data, size, jsonClassifier());
+    }
+
+    void build(const char *data, size_t size, JsonClassifyFn classify)
+    {
+        if (size > UINT32_MAX) throw std::runtime_error("JSON input too large for structural index");
+
+        positions.clear();
+        positions.reserve(size / 8 + 64);
+
+        uint64_t prevEscaped = 0;
+        uint64_t prevInString = 0;
+        uint64_t prevScalar = 0;
+        char tail[64];
+
+        for (size_t off = 0; off < size; off += 64)
+        {
+            const char *in = data + off;
+            if (size - off < 64) {
+                memset(tail, ' ', sizeof(tail));
+                memcpy(tail, in, size - off);
+                in = tail;
+            }
+
+            JsonBlockMasks m = classify(in);
+
+            uint64_t escaped = escapedMask(m.backslash, prevEscaped);
+            uint64_t quote = m.quote & ~escaped;
+
+            // bits from an opening quote up to (not including) its closing quote
+            uint64_t inString = prefixXor(quote) ^ prevInString;
+            prevInString = (uint64_t)((int64_t)inString >> 63);
+
+            uint64_t scalar = ~(m.op | m.space | m.quote | inString);
+            uint64_t scalarStart = scalar & ~((scalar << 1) | prevScalar);
+            prevScalar = scalar >> 63;
+
+            uint64_t structural = (m.op & ~inString) | (quote & inString) | scalarStart;
+            while (structural) {
+                positions.push_back((uint32_t)(off + __builtin_ctzll(structural)));
+                structural &= structural - 1;
+            }
+        }
+
+        if (prevInString) throw std::runtime_error("Unterminated JSON string");
+    }
+
+    // Bits of characters preceded by an unescaped backslash. Backslashes
+    // are rare, so walking them one at a time beats a branchless scheme.
+    static uint64_t escapedMask(uint64_t backslash, uint64_t &prevEscaped)
+    {
+        uint64_t escaped = 0;
+
+        if (prevEscaped) {
+            escaped |= 1;
+            backslash &= ~1ULL;
+        }
+        prevEscaped = 0;
+
+        while (backslash) {
+            int n = __builtin_ctzll(backslash);
+            if (n == 63) {
+                prevEscaped = 1;
+                break;
+            }
+            escaped |= 1ULL << (n + 1);
+            backslash &= ~(3ULL << n);
+        }
+        return escaped;
+    }
+
+    static uint64_t prefixXor(uint64_t x)
+    {
+        x ^= x << 1;
+        x ^= x << 2;
+        x ^= x << 4;
+        x ^= x << 8;
+        x ^= x << 16;
+        x ^= x << 32;
+        return x;
+    }
+};
+
+//
+// Stage 2: walks the structural index and reports events to a handler,
+// reusing JsonScanner's string/number decoding.
+//
+template <typename Handler>
+struct JsonIndexReader : public JsonScanner
+{
+    Handler &handler;
+    JsonStructuralIndex index;
+    const uint32_t *tok = nullptr;
+    const uint32_t *tokEnd = nullptr;
+
+    JsonIndexReader(const char *data, size_t size, Handler &_handler) : JsonScanner(data, size), handler(_handler)
+    {
+        index.build(data, size);
+        tok = index.positions.data();
+        tokEnd = tok + index.positions.size();
+    }
+    JsonIndexReader(std::string_view json, Handler &_handler) : JsonIndexReader(json.data(), json.size(), _handler) {}
+
+    void parse()
+    {
+        parseValue();
+        if (tok != tokEnd) {
+            p = begin + *tok;
+            error("Invalid JSON trailing characters");
+        }
+    }
+
+    // Moves to the next indexed position and returns the byte there.
+    char next()
+    {
+        if (tok == tokEnd) {
+            p = end;
+            error("Unexpected end of JSON input");
+        }
+        p = begin + *tok++;
+        return *p;
+    }
+
+    char peek() const { return tok == tokEnd ? '\0' : begin[*tok]; }
+
+    // Whatever lies between a number/literal and the next indexed
+    // position must be whitespace.
+    void endScalar()
+    {
+        const char *stop = (tok == tokEnd) ? end : begin + *tok;
+        for (; p != stop; p++) {
+            if (!isSpace(*p)) error("Invalid JSON token");
+        }
+    }
+
+    //
+    // The string opening at p. Stage 1 only indexes opening quotes, but
+    // anything after a closing quote other than whitespace is indexed, so
+    // the closing quote is the last byte before the next indexed position
+    // that isn't whitespace. Knowing where the body ends, only backslashes
+    // need looking for, with memchr; a body without any is returned as is.
+    //
+    std::string_view indexedString()
+    {
+        const char *stop = (tok == tokEnd) ? end : begin + *tok;
+        const char *close = stop - 1;
+        while (close != p && isSpace(*close)) close--;
+        if (close == p || *close != '"') error("Unterminated JSON string");
+
+        const char *start = p + 1;
+        const char *slash = (const char *)memchr(start, '\\', close - start);
+        if (!slash) {
+            p = stop;
+            return std::string_view(start, close - start);
+        }
+
+        scratch.assign(start, slash - start);
+        p = slash;
+        while (1)
+        {
+            parseEscape(scratch);
+            slash = (const char *)memchr(p, '\\', close - p);
+            if (!slash) break;
+            scratch.append(p, slash - p);
+            p = slash;
+        }
+        scratch.append(p, close - p);
+        p = stop;
+        return scratch;
+    }
+
+    void parseValue()
+    {
+        switch (next())
+        {
+        // OBJECT
+        case '{':
+            parseObject();
+            return;
+        // ARRAY
+        case '[':
+            parseArray();
+            return;
+        // STRING
+        case '"':
+            handler.onString(indexedString());
+            return;
+        // BOOL/NULL
+        case 't':
+            literal("true");
+            endScalar();
+            handler.onBool(true);
+            return;
+        case 'f':
+            literal("false");
+            endScalar();
+            handler.onBool(false);
+            return;
+        case 'n':
+            literal("null");
+            endScalar();
+            handler.onNull();
+            return;
+        case ',': case ':': case '}': case ']':
+            error("Invalid JSON token");
+        // NUMERIC
+        default:
+            parseNumber(handler);
+            endScalar();
+            return;
+        }
+    }
+
+    void parseObject()
+    {
+        nest();
+        handler.onStartObject();
+
+        if (peek() == '}') {
+            tok++;
+            handler.onEndObject();
+            depth--;
+            return;
+        }
+
+        while (1)
+        {
+            //
+            // KEY
+            //
+            if (next() != '"') error("Invalid JSON key sequence");
+            std::string_view key = indexedString();
+            if (next() != ':') error("Invalid JSON key sequence");
+            handler.onKey(key);
+
+            //
+            // VALUE
+            //
+            parseValue();
+
+            char c = next();
+            if (c == ',') continue;
+            if (c == '}') {
+                handler.onEndObject();
+                depth--;
+                return;
+            }
+            error("Invalid JSON Object");
+        }
+    }
+
+    void parseArray()
+    {
+        nest();
+        handler.onStartArray();
+
+        if (peek() == ']') {
+            tok++;
+            handler.onEndArray();
+            depth--;
+            return;
+        }
+
+        while (1)
+        {
+            parseValue();
+
+            char c = next();
+            if (c == ',') continue;
+            if (c == ']') {
+                handler.onEndArray();
+                depth--;
+                return;
+            }
+            error("Invalid JSON Array");
+        }
+    }
+};
+
+using JsonIndexParser = JsonBasicParser<JsonIndexReader>;
+
+template <typename Handler>
+inline void parseJsonIndexedSax(std::string_view json, Handler &handler)
+{
+    runJsonReader<JsonIndexReader>(json.data(), json.size(), handler);
+}
+
+inline JsonValue parseJsonIndexed(const char *data, size_t size, std::pmr::memory_resource *mr = std::pmr::get_default_resource(), JsonKeyPool *keys = nullptr)
+{
+    return JsonIndexParser(data, size, mr, keys).parse();
+}
+
+inline JsonValue parseJsonIndexed(std::string_view json, std::pmr::memory_resource *mr = std::pmr::get_default_resource(), JsonKeyPool *keys = nullptr)
+{
+    return JsonIndexParser(json, mr, keys).parse();
+}
+
+#endif
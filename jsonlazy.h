@@ -0,0 +1,252 @@
+#ifndef JSONLAZY_H
+#define JSONLAZY_H
+
+#include "json.h"
+
+//
+// On-demand access. A JsonLazyValue is only the position of a value in
+// the input. Looking up a key or an index scans forward from there,
+// decoding just the keys it compares and skipping every other subtree by
+// matching brackets and quotes, without allocating. Skipped text is not
+// validated, so a malformed document is reported only where it is read.
+// The input must outlive every value taken from it.
+//
+struct JsonLazyValue
+{
+    const char *doc = nullptr;
+    const char *pos = nullptr;      // first byte of the value, nullptr if missing
+    const char *end = nullptr;
+
+    JsonLazyValue() = default;
+    JsonLazyValue(const char *_doc, const char *_pos, const char *_end) : doc(_doc), pos(_pos), end(_end) {}
+
+    // False for a key or index that isn't there. Lookups on a missing
+    // value are missing too, so a chain only needs checking at the end.
+    explicit operator bool() const { return pos != nullptr; }
+
+    JsonType type() const
+    {
+        switch (first())
+        {
+        case '{': return JsonType::Object;
+        case '[': return JsonType::Array;
+        case '"': return JsonType::String;
+        case 't': case 'f': return JsonType::Bool;
+        case 'n': return JsonType::Null;
+        default: return get().type;     // numbers don't allocate
+        }
+    }
+
+    bool isNull() const { return pos && first() == 'n'; }
+    bool isBool() const { return pos && (first() == 't' || first() == 'f'); }
+    bool isString() const { return pos && first() == '"'; }
+    bool isArray() const { return pos && first() == '['; }
+    bool isObject() const { return pos && first() == '{'; }
+    bool isNumber() const { return pos && !isNull() && !isBool() && !isString() && !isArray() && !isObject(); }
+
+    bool asBool() const { return get().asBool(); }
+    int64_t asInt() const { return get().asInt(); }
+    uint64_t asUint() const { return get().asUint(); }
+    double asFloat() const { return get().asFloat(); }
+
+    std::string asString() const
+    {
+        check(JsonType::String);
+        JsonScanner s = scanner();
+        return std::string(s.parseString());
+    }
+
+    // First member named key; missing if there is none.
+    JsonLazyValue operator[](std::string_view key) const
+    {
+        JsonLazyValue found;
+        if (pos) {
+            check(JsonType::Object);
+            walk([&](std::string_view k, const JsonLazyValue &val) {
+                if (k != key) return true;
+                found = val;
+                return false;
+            });
+        }
+        return found;
+    }
+
+    JsonLazyValue operator[](size_t index) const
+    {
+        JsonLazyValue found;
+        if (pos) {
+            check(JsonType::Array);
+            walk([&](std::string_view, const JsonLazyValue &val) {
+                if (index--) return true;
+                found = val;
+                return false;
+            });
+        }
+        return found;
+    }
+
+    // f(element) for each array element.
+    template <typename F>
+    void forEachElement(F &&f) const
+    {
+        check(JsonType::Array);
+        walk([&](std::string_view, const JsonLazyValue &val) {
+            f(val);
+            return true;
+        });
+    }
+
+    // f(key, value) for each object member; key is only valid during the call.
+    template <typename F>
+    void forEachMember(F &&f) const
+    {
+        check(JsonType::Object);
+        walk([&](std::string_view key, const JsonLazyValue &val) {
+            f(key, val);
+            return true;
+        });
+    }
+
+    // Calls visit(key, value) for each member or element, with an empty
+    // key for arrays, until it returns false. Nothing past the value it
+    // stopped at is read, so later malformed text goes unnoticed.
+    template <typename Visit>
+    void walk(Visit &&visit) const
+    {
+        if (!isObject() && !isArray()) check(JsonType::Array);
+        JsonScanner s = scanner();
+        bool object = (*s.p++ == '{');
+        char close = object ? '}' : ']';
+
+        s.skipSpace();
+        if (s.p != s.end && *s.p == close) return;
+
+        while (1)
+        {
+            std::string_view key;
+            if (object) {
+                s.skipSpace();
+                if (s.p == s.end || *s.p != '"') s.error("Invalid JSON key sequence");
+                key = s.parseString();
+                s.expect(':', "Invalid JSON key sequence");
+            }
+
+            s.skipSpace();
+            if (s.p == s.end) s.error("Unexpected end of JSON input");
+            if (!visit(key, JsonLazyValue(doc, s.p, end))) return;
+            skipValue(s);
+
+            s.skipSpace();
+            if (s.p == s.end) s.error("Unexpected end of JSON input");
+            if (*s.p == ',') {
+                s.p++;
+                continue;
+            }
+            if (*s.p == close) return;
+            s.error(object ? "Invalid JSON Object" : "Invalid JSON Array");
+        }
+    }
+
+    // Parses this value, and everything under it, into a DOM.
+    JsonValue get(std::pmr::memory_resource *mr = std::pmr::get_default_resource(), JsonKeyPool *keys = nullptr) const
+    {
+        first();
+        JsonDomBuilder builder(mr, keys);
+        JsonScanner s = scanner();
+        runJsonReaderAt(s, builder);
+        return std::move(builder.root);
+    }
+
+    // The value's text, found by skipping over it.
+    std::string_view raw() const
+    {
+        JsonScanner s = scanner();
+        skipValue(s);
+        return std::string_view(pos, s.p - pos);
+    }
+
+    static void skipString(JsonScanner &s)
+    {
+        const char *p = s.p + 1;
+        while (1)
+        {
+            while (p != s.end && *p != '"' && *p != '\\') p++;
+            if (p != s.end && *p == '"') break;
+            if (s.end - p < 2) {
+                s.p = s.end;
+                s.error("Unterminated JSON string");
+            }
+            p += 2;     // backslash and the byte it escapes
+        }
+        s.p = p + 1;
+    }
+
+    static void skipValue(JsonScanner &s)
+    {
+        switch (*s.p)
+        {
+        case '"':
+            skipString(s);
+            return;
+        case '{': case '[': {
+            size_t depth = 0;
+            while (1)
+            {
+                if (s.p == s.end) s.error("Unexpected end of JSON input");
+                switch (*s.p)
+                {
+                case '"':
+                    skipString(s);
+                    continue;
+                case '{': case '[':
+                    depth++;
+                    break;
+                case '}': case ']':
+                    if (--depth == 0) {
+                        s.p++;
+                        return;
+                    }
+                    break;
+                }
+                s.p++;
+            }
+        }
+        case ',': case ':': case '}': case ']':
+            s.error("Invalid JSON token");
+        default:
+            while (s.p != s.end && !JsonScanner::isSpace(*s.p) && *s.p != ',' && *s.p != '}' && *s.p != ']') s.p++;
+            return;
+        }
+    }
+
+private:
+    char first() const
+    {
+        if (!pos) throw std::runtime_error("Missing JSON value");
+        return *pos;
+    }
+
+    void check(JsonType t) const
+    {
+        JsonType actual = type();
+        if (actual != t) throw std::runtime_error(std::string("Invalid JSON type: ") + jsonTypeName(actual));
+    }
+
+    JsonScanner scanner() const
+    {
+        JsonScanner s(doc, end - doc);
+        s.p = pos;
+        return s;
+    }
+};
+
+// Returns the root of json without parsing any of it.
+inline JsonLazyValue parseJsonLazy(std::string_view json)
+{
+    JsonScanner s(json.data(), json.size());
+    s.skipSpace();
+    if (s.p == s.end) s.error("Unexpected end of JSON input");
+    return JsonLazyValue(s.begin, s.p, s.end);
+}
+
+#endif
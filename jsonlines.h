@@ -0,0 +1,92 @@
+#ifndef JSONLINES_H
+#define JSONLINES_H
+
+#include <cstring>
+
+#include "json.h"
+#include "jsonfile.h"
+#include "jsonpool.h"
+
+//
+// JSON Lines (NDJSON): one value per line. A raw newline can't appear
+// inside a JSON string, so every '\n' is a record boundary and the input
+// splits with a plain memchr pass; the records are then parsed in
+// parallel on a JsonThreadPool. Blank lines are skipped and a trailing
+// '\r' is left to the parser as whitespace.
+//
+
+struct JsonLine
+{
+    std::string_view text;
+    size_t line;        // 1-based line number in the input
+};
+
+inline std::vector<JsonLine> splitJsonLines(std::string_view input)
+{
+    std::vector<JsonLine> lines;
+    const char *p = input.data();
+    const char *end = p + input.size();
+
+    for (size_t line = 1; p != end; line++)
+    {
+        const char *nl = (const char *)memchr(p, '\n', end - p);
+        const char *stop = nl ? nl : end;
+
+        for (const char *q = p; q != stop; q++) {
+            if (!JsonScanner::isSpace(*q)) {
+                lines.push_back({std::string_view(p, stop - p), line});
+                break;
+            }
+        }
+        p = nl ? nl + 1 : end;
+    }
+    return lines;
+}
+
+//
+// Parses every record and hands it to callback(value, index, worker) on
+// the worker thread that parsed it. index is the record's position among
+// the non-blank lines; worker (0..pool.size()-1) selects per-thread state,
+// so callbacks that only touch their own slot need no locking. Errors name
+// the offending line.
+//
+template <typename Callback>
+inline void parseJsonLines(const std::vector<JsonLine> &lines, JsonThreadPool &pool, Callback &&callback, JsonKeyPool *keys = nullptr)
+{
+    pool.parallelFor(lines.size(), pool.grainFor(lines.size()), [&](size_t begin, size_t end, unsigned worker) {
+        for (size_t n = begin; n < end; n++)
+        {
+            JsonValue val;
+            try {
+                val = JsonParser(lines[n].text, std::pmr::get_default_resource(), keys).parse();
+            } catch (const std::runtime_error &e) {
+                throw std::runtime_error("line " + std::to_string(lines[n].line) + ": " + e.what());
+            }
+            callback(std::move(val), n, worker);
+        }
+    });
+}
+
+template <typename Callback>
+inline void parseJsonLines(std::string_view input, JsonThreadPool &pool, Callback &&callback, JsonKeyPool *keys = nullptr)
+{
+    parseJsonLines(splitJsonLines(input), pool, callback, keys);
+}
+
+// Parses every record and returns them in input order.
+inline std::vector<JsonValue> parseJsonLines(std::string_view input, JsonThreadPool &pool, JsonKeyPool *keys = nullptr)
+{
+    std::vector<JsonLine> lines = splitJsonLines(input);
+    std::vector<JsonValue> values(lines.size());
+
+    parseJsonLines(lines, pool, [&](JsonValue &&val, size_t n, unsigned) { values[n] = std::move(val); }, keys);
+    return values;
+}
+
+inline std::vector<JsonValue> parseJsonLinesFile(const std::string &path, JsonThreadPool &pool, JsonKeyPool *keys = nullptr)
+{
+    JsonMappedFile file(path);
+    return parseJsonLines(file.view(), pool, keys);
+}
+
+#endif
@@ -0,0 +1,354 @@
+#ifndef JSONMINIFY_H
+#define JSONMINIFY_H
+
+#include <cstring>
+
+#include "json.h"
+
+//
+// Validation and minification without building anything. One pass checks
+// the text against the RFC 8259 grammar and copies it to out minus the
+// whitespace between tokens; tokens are copied verbatim, escapes and all.
+// Stricter than the parsers: control characters in strings, malformed
+// UTF-8 and unpaired surrogate escapes are rejected, so any text that
+// validates also parses.
+//
+// Nothing is allocated and nothing recurses. Open containers are one bit
+// each in a fixed stack, which caps nesting at maxDepth.
+//
+struct JsonNullSink
+{
+    void append(const char *, size_t) {}
+    void push_back(char) {}
+};
+
+template <typename Sink>
+struct JsonMinifier
+{
+    static constexpr uint32_t maxDepth = 1024;
+
+    const char *begin;
+    const char *p;
+    const char *end;
+    const char *copied;         // start of the bytes not yet copied to out
+    Sink &out;
+    const char *what = nullptr; // why the input is invalid
+    uint32_t depth = 0;
+    uint64_t objects[maxDepth / 64];    // bit set for an open object, clear for an array
+
+    JsonMinifier(std::string_view json, Sink &_out) : begin(json.data()), p(begin), end(begin + json.size()), copied(begin), out(_out) {}
+
+    // False if the input is invalid, with what and p saying why and where.
+    bool run()
+    {
+        space();
+        while (1)
+        {
+            //
+            // VALUE
+            //
+            if (p == end) return fail("Unexpected end of JSON input");
+            switch (*p)
+            {
+            case '{':
+                if (!open(true)) return false;
+                if (p != end && *p == '}') {
+                    p++;
+                    depth--;
+                    break;
+                }
+                if (!key()) return false;
+                continue;
+            case '[':
+                if (!open(false)) return false;
+                if (p != end && *p == ']') {
+                    p++;
+                    depth--;
+                    break;
+                }
+                continue;
+            case '"':
+                if (!string()) return false;
+                break;
+            case 't':
+                if (!literal("true")) return false;
+                break;
+            case 'f':
+                if (!literal("false")) return false;
+                break;
+            case 'n':
+                if (!literal("null")) return false;
+                break;
+            default:
+                if (!number()) return false;
+                break;
+            }
+
+            //
+            // AFTER A VALUE: close containers until a comma or the end
+            //
+            while (1)
+            {
+                space();
+                if (depth == 0) {
+                    if (p != end) return fail("Invalid JSON trailing characters");
+                    out.append(copied, p - copied);
+                    return true;
+                }
+                if (p == end) return fail("Unexpected end of JSON input");
+
+                bool object = (objects[(depth - 1) / 64] >> ((depth - 1) % 64)) & 1;
+                if (*p == ',') {
+                    p++;
+                    space();
+                    if (object && !key()) return false;
+                    break;
+                }
+                if (*p != (object ? '}' : ']')) return fail(object ? "Invalid JSON Object" : "Invalid JSON Array");
+                p++;
+                depth--;
+            }
+        }
+    }
+
+private:
+    bool fail(const char *msg)
+    {
+        what = msg;
+        return false;
+    }
+
+    // Skips whitespace, copying the bytes before it first.
+    void space()
+    {
+        if (p == end || !JsonScanner::isSpace(*p)) return;
+        out.append(copied, p - copied);
+        const char *q = p;
+        while (++q != end && JsonScanner::isSpace(*q)) {}
+        p = copied = q;
+    }
+
+    bool open(bool object)
+    {
+        if (depth == maxDepth) return fail("JSON nesting too deep");
+
+        uint64_t bit = 1ULL << (depth % 64);
+        if (object) objects[depth / 64] |= bit;
+        else objects[depth / 64] &= ~bit;
+        depth++;
+
+        p++;
+        space();
+        return true;
+    }
+
+    // A key, its colon, and the whitespace up to the value.
+    bool key()
+    {
+        if (p == end || *p != '"') return fail("Invalid JSON key sequence");
+        if (!string()) return false;
+        space();
+        if (p == end || *p != ':') return fail("Invalid JSON key sequence");
+        p++;
+        space();
+        return true;
+    }
+
+    bool literal(std::string_view word)
+    {
+        if ((size_t)(end - p) < word.size() || memcmp(p, word.data(), word.size()) != 0) return fail("Invalid JSON token");
+        p += word.size();
+        return true;
+    }
+
+    bool digits()
+    {
+        const char *q = p;
+        if (q == end || !JsonScanner::isDigit(*q)) return fail("Invalid JSON number");
+        while (++q != end && JsonScanner::isDigit(*q)) {}
+        p = q;
+        return true;
+    }
+
+    bool number()
+    {
+        if (*p == '-') p++;
+        if (p != end && *p == '0') {
+            p++;
+        } else if (!digits()) {
+            return false;
+        }
+        if (p != end && *p == '.') {
+            p++;
+            if (!digits()) return false;
+        }
+        if (p != end && (*p == 'e' || *p == 'E')) {
+            p++;
+            if (p != end && (*p == '+' || *p == '-')) p++;
+            if (!digits()) return false;
+        }
+        return true;
+    }
+
+    //
+    // STRING
+    //
+    // Eight bytes at a time while none of them is a quote, a backslash, a
+    // control character or non-ASCII; those are handled one by one.
+    //
+    static bool special(uint64_t w)
+    {
+        constexpr uint64_t ones = 0x0101010101010101ULL;
+        constexpr uint64_t high = 0x8080808080808080ULL;
+
+        uint64_t quote = w ^ (ones * '"');
+        uint64_t slash = w ^ (ones * '\\');
+        uint64_t found = ((quote - ones) & ~quote) | ((slash - ones) & ~slash) | ((w - ones * 0x20) & ~w) | w;
+        return (found & high) != 0;
+    }
+
+    bool string()
+    {
+        p++;
+        while (1)
+        {
+            const char *q = p;
+            while (end - q >= 8) {
+                uint64_t w;
+                memcpy(&w, q, sizeof(w));
+                if (special(w)) break;
+                q += 8;
+            }
+            p = q;
+
+            if (p == end) return fail("Unterminated JSON string");
+            unsigned char c = *p;
+            if (c == '"') {
+                p++;
+                return true;
+            }
+            if (c == '\\') {
+                if (!escape()) return false;
+            } else if (c < 0x20) {
+                return fail("Invalid JSON control character");
+            } else if (c >= 0x80) {
+                if (!utf8()) return fail("Invalid UTF-8 in JSON string");
+            } else {
+                p++;
+            }
+        }
+    }
+
+    bool hex4(uint32_t &code)
+    {
+        if (end - p < 4) return fail("Invalid JSON unicode escape");
+        code = 0;
+        for (int n = 0; n < 4; n++, p++)
+        {
+            char c = *p;
+            code <<= 4;
+            if (c >= '0' && c <= '9') code |= c - '0';
+            else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+            else return fail("Invalid JSON unicode escape");
+        }
+        return true;
+    }
+
+    bool escape()
+    {
+        p++;
+        if (p == end) return fail("Unterminated JSON string");
+        switch (*p++)
+        {
+        case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+            return true;
+        case 'u':
+            break;
+        default:
+            p--;
+            return fail("Invalid JSON escape sequence");
+        }
+
+        uint32_t code;
+        if (!hex4(code)) return false;
+        if (code >= 0xDC00 && code <= 0xDFFF) return fail("Invalid JSON surrogate pair");
+        if (code < 0xD800 || code > 0xDBFF) return true;
+
+        if (end - p < 2 || p[0] != '\\' || p[1] != 'u') return fail("Invalid JSON surrogate pair");
+        p += 2;
+        if (!hex4(code)) return false;
+        if (code < 0xDC00 || code > 0xDFFF) return fail("Invalid JSON surrogate pair");
+        return true;
+    }
+
+    // One well-formed UTF-8 sequence (RFC 3629): no overlong forms, no
+    // surrogates, nothing past U+10FFFF.
+    bool utf8()
+    {
+        unsigned char c = *p;
+        int len;
+        unsigned char lo = 0x80, hi = 0xBF;     // range of the second byte
+
+        if (c >= 0xC2 && c <= 0xDF) len = 2;
+        else if (c >= 0xE0 && c <= 0xEF) len = 3;
+        else if (c >= 0xF0 && c <= 0xF4) len = 4;
+        else return false;
+
+        if (c == 0xE0) lo = 0xA0;
+        else if (c == 0xED) hi = 0x9F;
+        else if (c == 0xF0) lo = 0x90;
+        else if (c == 0xF4) hi = 0x8F;
+
+        if (end - p < len) return false;
+        if ((unsigned char)p[1] < lo || (unsigned char)p[1] > hi) return false;
+        for (int n = 2; n < len; n++)
+        {
+            if (((unsigned char)p[n] & 0xC0) != 0x80) return false;
+        }
+        p += len;
+        return true;
+    }
+};
+
+inline bool validateJson(std::string_view json)
+{
+    JsonNullSink sink;
+    return JsonMinifier<JsonNullSink>(json, sink).run();
+}
+
+// Throws for invalid input, saying what is wrong and where.
+inline void checkJson(std::string_view json)
+{
+    JsonNullSink sink;
+    JsonMinifier<JsonNullSink> minifier(json, sink);
+    if (!minifier.run()) throw std::runtime_error(std::string(minifier.what) + " at offset " + std::to_string(minifier.p - minifier.begin));
+}
+
+// Appends json without insignificant whitespace to out, or throws for
+// invalid input. A std::string is left as it was on error; other sinks
+// may have been given a prefix.
+template <typename Sink>
+inline void minifyJson(std::string_view json, Sink &out)
+{
+    size_t size = 0;
+    if constexpr (std::is_same_v<Sink, std::string>) {
+        size = out.size();
+        out.reserve(size + json.size());
+    }
+
+    JsonMinifier<Sink> minifier(json, out);
+    if (minifier.run()) return;
+
+    if constexpr (std::is_same_v<Sink, std::string>) out.resize(size);
+    throw std::runtime_error(std::string(minifier.what) + " at offset " + std::to_string(minifier.p - minifier.begin));
+}
+
+inline std::string minifyJson(std::string_view json)
+{
+    std::string out;
+    minifyJson(json, out);
+    return out;
+}
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef JSONPARALLEL_H
+#define JSONPARALLEL_H
+
+#include "json.h"
+#include "jsonpool.h"
+
+//
+// Parallel serialization. The value is cut into parts in document order:
+// every array or object of at least minSplit entries becomes runs of
+// consecutive entries, and the punctuation and keys around them become
+// short literal parts. The parts are written concurrently on a pool into
+// separate buffers, and joined they are byte for byte what writeJson()
+// produces.
+//
+// Planning looks at the entries of a large container but does not
+// descend into small ones beyond a fixed budget, so a large container
+// must be within a few small wrappers of the root ({"data": [...]} is
+// found, an array of arrays of small objects is written as one part).
+//
+struct JsonParallelWriter
+{
+    struct Part
+    {
+        std::string text;                   // literal text when val is null
+        const JsonValue *val = nullptr;     // the whole value, or its entries [begin, end)
+        size_t begin = 0;
+        size_t end = 0;
+        bool range = false;
+    };
+
+    static constexpr size_t smallBudget = 1024;     // entries of small containers looked into
+
+    size_t minSplit;
+    size_t grain;
+    size_t budget = smallBudget;
+    std::vector<Part> parts;
+    bool split = false;
+
+    JsonParallelWriter(const JsonValue &val, size_t _minSplit, size_t _grain) : minSplit(_minSplit), grain(_grain) { plan(val); }
+
+    // Writes each part to its own buffer; empty if nothing was big enough to split.
+    std::vector<std::string> write(JsonThreadPool &pool) const
+    {
+        std::vector<std::string> out;
+        if (!split) return out;
+
+        out.resize(parts.size());
+        pool.parallelFor(parts.size(), pool.grainFor(parts.size()), [&](size_t begin, size_t end, unsigned) {
+            for (size_t n = begin; n < end; n++) writePart(parts[n], out[n]);
+        });
+        return out;
+    }
+
+private:
+    void text(std::string_view str)
+    {
+        if (parts.empty() || parts.back().val) parts.emplace_back();
+        parts.back().text.append(str.data(), str.size());
+    }
+
+    void whole(const JsonValue &val)
+    {
+        parts.emplace_back();
+        parts.back().val = &val;
+    }
+
+    void plan(const JsonValue &val)
+    {
+        if (!val.isArray() && !val.isObject()) return whole(val);
+
+        size_t size = val.isArray() ? val.a->size() : val.o->size();
+        if (size < minSplit) {
+            if (size > budget) return whole(val);
+            budget -= size;
+        }
+
+        bool object = val.isObject();
+        text(object ? "{" : "[");
+
+        // runs of up to grain entries, broken around entries that split themselves
+        size_t run = 0;
+        for (size_t n = 0; n < size; n++)
+        {
+            const JsonValue &entry = object ? (val.o->begin() + n)->second : (*val.a)[n];
+            if (size < minSplit || large(entry)) {
+                flush(val, run, n);
+                if (n) text(",");
+                if (object) key((val.o->begin() + n)->first);
+                plan(entry);
+                run = n + 1;
+            } else if (n + 1 - run == grain) {
+                flush(val, run, n + 1);
+                run = n + 1;
+            }
+        }
+        if (size >= minSplit) flush(val, run, size);
+
+        text(object ? "}" : "]");
+    }
+
+    bool large(const JsonValue &val) const
+    {
+        return (val.isArray() && val.a->size() >= minSplit) || (val.isObject() && val.o->size() >= minSplit);
+    }
+
+    void key(const JsonKey &key)
+    {
+        if (parts.empty() || parts.back().val) parts.emplace_back();
+        JsonWriter<std::string> writer(parts.back().text);
+        writer.writeString(key);
+        parts.back().text.push_back(':');
+    }
+
+    // Entries [begin, end) of a container as one part.
+    void flush(const JsonValue &val, size_t begin, size_t end)
+    {
+        if (begin == end) return;
+        split = true;
+        parts.emplace_back();
+        Part &part = parts.back();
+        part.val = &val;
+        part.begin = begin;
+        part.end = end;
+        part.range = true;
+    }
+
+    static void writePart(const Part &part, std::string &out)
+    {
+        if (!part.val) {
+            out = part.text;
+            return;
+        }
+
+        JsonWriter<std::string> writer(out);
+        if (!part.range) return writer.write(*part.val);
+
+        for (size_t n = part.begin; n < part.end; n++)
+        {
+            if (n) out.push_back(',');
+            if (part.val->isArray()) {
+                writer.write((*part.val->a)[n]);
+            } else {
+                auto &[key, member] = *(part.val->o->begin() + n);
+                writer.writeString(key);
+                out.push_back(':');
+                writer.write(member);
+            }
+        }
+    }
+};
+
+// Below this many entries a container is not worth splitting.
+constexpr size_t jsonParallelMinSplit = 1 << 14;
+
+//
+// The parts of val, in order, for handing to writev() or a socket. A
+// value with nothing to split comes back as a single part.
+//
+inline std::vector<std::string> writeJsonParts(const JsonValue &val, JsonThreadPool &pool, size_t minSplit = jsonParallelMinSplit)
+{
+    size_t grain = std::max<size_t>(256, minSplit / 4);
+    std::vector<std::string> parts = JsonParallelWriter(val, minSplit, grain).write(pool);
+    if (parts.empty()) {
+        parts.push_back(toJson(val));
+        return parts;
+    }
+
+    JSON_STATS_ONLY(for (auto &part : parts) jsonStats().bytesWritten += part.size());
+    return parts;
+}
+
+inline void writeJsonParallel(std::string &out, const JsonValue &val, JsonThreadPool &pool, size_t minSplit = jsonParallelMinSplit)
+{
+    std::vector<std::string> parts = writeJsonParts(val, pool, minSplit);
+
+    size_t total = out.size();
+    for (auto &part : parts) total += part.size();
+    out.reserve(total);
+    for (auto &part : parts) out += part;
+}
+
+// Writes the parts one after another, without joining them first.
+inline std::ostream &writeJsonParallel(std::ostream &os, const JsonValue &val, JsonThreadPool &pool, size_t minSplit = jsonParallelMinSplit)
+{
+    for (auto &part : writeJsonParts(val, pool, minSplit)) os.write(part.data(), part.size());
+    return os;
+}
+
+#endif
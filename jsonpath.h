@@ -0,0 +1,274 @@
+#ifndef JSONPATH_H
+#define JSONPATH_H
+
+#include "json.h"
+#include "jsonlazy.h"
+
+//
+// Compiled queries. A JsonPath is built once from either an RFC 6901
+// JSON Pointer ("/a/b/3", "~1" for '/' and "~0" for '~') or a small path
+// language ("$.a.b[3]", "$['a.b']", "*" or "[*]" for every member or
+// element), and then evaluated any number of times against a DOM, or
+// against raw text through JsonLazyValue, where only the matches are
+// ever decoded.
+//
+struct JsonPath
+{
+    enum class StepKind : uint8_t
+    {
+        Member,     // .name or ['name']
+        Element,    // [3]
+        Token,      // pointer token: a member name, or an index into an array
+        Wildcard    // * or [*]
+    };
+
+    struct Step
+    {
+        StepKind kind;
+        std::string name;
+        size_t index;
+    };
+
+    static constexpr size_t noIndex = (size_t)-1;
+
+    std::vector<Step> steps;
+
+    JsonPath() = default;
+
+    // A pointer when expr is empty or starts with '/', otherwise a path
+    // starting with '$'.
+    explicit JsonPath(std::string_view expr)
+    {
+        if (expr.empty() || expr[0] == '/') compilePointer(expr);
+        else compilePath(expr);
+    }
+
+    //
+    // DOM evaluation. f(value) is called for each match in document order
+    // and returns false to stop early.
+    //
+    template <typename F>
+    void select(const JsonValue &root, F &&f) const { walk(root, 0, f); }
+
+    template <typename F>
+    void select(JsonValue &root, F &&f) const { walk(root, 0, f); }
+
+    // A bare container isn't a JsonValue, so "$" or "" matches nothing here.
+    template <typename F>
+    void select(const JsonValue::Object &root, F &&f) const
+    {
+        if (!steps.empty()) walkObject(root, 0, f);
+    }
+
+    template <typename F>
+    void select(const JsonValue::Array &root, F &&f) const
+    {
+        if (!steps.empty()) walkArray(root, 0, f);
+    }
+
+    // First match, or nullptr.
+    template <typename Root>
+    auto find(Root &root) const
+    {
+        using Value = std::conditional_t<std::is_same_v<Root, JsonValue>, JsonValue, const JsonValue>;
+        Value *found = nullptr;
+        select(root, [&](Value &val) {
+            found = &val;
+            return false;
+        });
+        return found;
+    }
+
+    // Every match; root may be a JsonValue or a bare Object or Array.
+    template <typename Root>
+    std::vector<const JsonValue *> selectAll(const Root &root) const
+    {
+        std::vector<const JsonValue *> out;
+        select(root, [&](const JsonValue &val) {
+            out.push_back(&val);
+            return true;
+        });
+        return out;
+    }
+
+    // The matches would point into a temporary, including the one made
+    // by converting a bare container to a JsonValue.
+    template <typename Root>
+        requires(!std::is_reference_v<Root>)
+    std::vector<const JsonValue *> selectAll(Root &&) const = delete;
+
+    //
+    // Streaming evaluation over raw text. Subtrees off the path are skipped
+    // unparsed; f(match) gets a JsonLazyValue to decode as it likes.
+    //
+    template <typename F>
+    void select(const JsonLazyValue &root, F &&f) const { walkLazy(root, 0, f); }
+
+    // Parses only the matching subtrees of json.
+    std::vector<JsonValue> extract(std::string_view json, std::pmr::memory_resource *mr = std::pmr::get_default_resource()) const
+    {
+        std::vector<JsonValue> out;
+        select(parseJsonLazy(json), [&](const JsonLazyValue &val) {
+            out.push_back(val.get(mr));
+            return true;
+        });
+        return out;
+    }
+
+private:
+    [[noreturn]] static void error(const char *what, size_t offset)
+    {
+        throw std::runtime_error(std::string(what) + " at offset " + std::to_string(offset));
+    }
+
+    // Decimal array index without leading zeros, or noIndex.
+    static size_t parseIndex(std::string_view s)
+    {
+        if (s.empty() || (s.size() > 1 && s[0] == '0')) return noIndex;
+        size_t n = 0;
+        auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), n);
+        if (ec != std::errc() || ptr != s.data() + s.size()) return noIndex;
+        return n;
+    }
+
+    void compilePointer(std::string_view expr)
+    {
+        size_t pos = 0;
+        while (pos < expr.size())
+        {
+            size_t next = expr.find('/', pos + 1);
+            if (next == std::string_view::npos) next = expr.size();
+
+            std::string token;
+            for (size_t n = pos + 1; n < next; n++)
+            {
+                if (expr[n] != '~') {
+                    token += expr[n];
+                    continue;
+                }
+                if (n + 1 == next || (expr[n + 1] != '0' && expr[n + 1] != '1')) {
+                    error("Invalid JSON pointer escape", n);
+                }
+                token += (expr[++n] == '0') ? '~' : '/';
+            }
+
+            size_t index = parseIndex(token);
+            steps.push_back({StepKind::Token, std::move(token), index});
+            pos = next;
+        }
+    }
+
+    void compilePath(std::string_view expr)
+    {
+        if (expr[0] != '$') error("Invalid JSON path", 0);
+
+        size_t pos = 1;
+        while (pos < expr.size())
+        {
+            if (expr[pos] == '.') {
+                size_t start = ++pos;
+                while (pos < expr.size() && expr[pos] != '.' && expr[pos] != '[') pos++;
+                std::string_view name = expr.substr(start, pos - start);
+                if (name.empty()) error("Invalid JSON path member", start);
+
+                if (name == "*") steps.push_back({StepKind::Wildcard, "", noIndex});
+                else steps.push_back({StepKind::Member, std::string(name), noIndex});
+                continue;
+            }
+
+            if (expr[pos] != '[') error("Invalid JSON path", pos);
+            pos++;
+
+            if (pos < expr.size() && (expr[pos] == '\'' || expr[pos] == '"')) {
+                char quote = expr[pos++];
+                std::string name;
+                while (pos < expr.size() && expr[pos] != quote) {
+                    if (expr[pos] == '\\' && pos + 1 < expr.size()) pos++;
+                    name += expr[pos++];
+                }
+                if (pos == expr.size()) error("Unterminated JSON path string", pos);
+                pos++;
+                steps.push_back({StepKind::Member, std::move(name), noIndex});
+            } else {
+                size_t start = pos;
+                while (pos < expr.size() && expr[pos] != ']') pos++;
+                std::string_view inner = expr.substr(start, pos - start);
+
+                if (inner == "*") {
+                    steps.push_back({StepKind::Wildcard, "", noIndex});
+                } else {
+                    size_t index = parseIndex(inner);
+                    if (index == noIndex) error("Invalid JSON path index", start);
+                    steps.push_back({StepKind::Element, "", index});
+                }
+            }
+
+            if (pos == expr.size() || expr[pos] != ']') error("Invalid JSON path", pos);
+            pos++;
+        }
+    }
+
+    template <typename Value, typename F>
+    bool walk(Value &val, size_t n, F &f) const
+    {
+        if (n == steps.size()) return f(val);
+        if (val.type == JsonType::Object) return walkObject(*val.o, n, f);
+        if (val.type == JsonType::Array) return walkArray(*val.a, n, f);
+        return true;
+    }
+
+    template <typename Object, typename F>
+    bool walkObject(Object &obj, size_t n, F &f) const
+    {
+        const Step &step = steps[n];
+
+        if (step.kind == StepKind::Wildcard) {
+            for (auto &member : obj) {
+                if (!walk(member.second, n + 1, f)) return false;
+            }
+            return true;
+        }
+        if (step.kind == StepKind::Element) return true;
+
+        auto it = obj.find(step.name);
+        return it == obj.end() || walk(it->second, n + 1, f);
+    }
+
+    template <typename Array, typename F>
+    bool walkArray(Array &arr, size_t n, F &f) const
+    {
+        const Step &step = steps[n];
+
+        if (step.kind == StepKind::Wildcard) {
+            for (auto &elem : arr) {
+                if (!walk(elem, n + 1, f)) return false;
+            }
+            return true;
+        }
+        if (step.kind == StepKind::Member || step.index >= arr.size()) return true;
+        return walk(arr[step.index], n + 1, f);
+    }
+
+    template <typename F>
+    bool walkLazy(const JsonLazyValue &val, size_t n, F &f) const
+    {
+        if (n == steps.size()) return f(val);
+
+        const Step &step = steps[n];
+        bool object = val.isObject();
+        if (!object && !val.isArray()) return true;
+
+        if (step.kind == StepKind::Wildcard) {
+            bool more = true;
+            val.walk([&](std::string_view, const JsonLazyValue &child) { return more = walkLazy(child, n + 1, f); });
+            return more;
+        }
+
+        JsonLazyValue child;
+        if (object && step.kind != StepKind::Element) child = val[std::string_view(step.name)];
+        if (!object && step.kind != StepKind::Member && step.index != noIndex) child = val[step.index];
+        return !child || walkLazy(child, n + 1, f);
+    }
+};
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef JSONPOOL_H
+#define JSONPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "json.h"
+
+//
+// Work-stealing thread pool. Each worker owns a deque: it takes work from
+// the front of its own and, when that runs dry, steals from the back of
+// the others, so uneven chunks (a few huge records, say) even out.
+//
+struct JsonThreadPool
+{
+    using Task = std::function<void(unsigned)>;
+
+    explicit JsonThreadPool(unsigned threads = std::thread::hardware_concurrency())
+    {
+        if (threads == 0) threads = 1;
+        for (unsigned n = 0; n < threads; n++) queues.push_back(std::make_unique<Queue>());
+        for (unsigned n = 0; n < threads; n++) workers.emplace_back([this, n] { run(n); });
+    }
+
+    ~JsonThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers) worker.join();
+    }
+
+    JsonThreadPool(const JsonThreadPool &) = delete;
+    JsonThreadPool &operator=(const JsonThreadPool &) = delete;
+
+    unsigned size() const { return (unsigned)workers.size(); }
+
+    //
+    // Calls f(begin, end, worker) over [0, n) in chunks of at most grain
+    // items and waits for all of them. worker is the index of the thread
+    // running the chunk, for per-thread state. The first exception thrown
+    // by a chunk is rethrown here once every chunk has finished. Not for
+    // use from inside a chunk: the caller blocks rather than helping out.
+    // With JSON_STATS, what the chunks count is added to the caller's
+    // jsonStats() before returning.
+    //
+    template <typename F>
+    void parallelFor(size_t n, size_t grain, F &&f)
+    {
+        if (n == 0) return;
+        if (grain == 0) grain = 1;
+
+        // Completion is counted under doneMutex, and the last chunk notifies
+        // before unlocking, so once the wait below sees zero no worker
+        // touches these locals again.
+        size_t chunks = (n + grain - 1) / grain;
+        size_t remaining = chunks;
+        std::mutex doneMutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+        JSON_STATS_ONLY(JsonStats counted);
+
+        for (size_t c = 0; c < chunks; c++)
+        {
+            size_t begin = c * grain;
+            size_t end = std::min(n, begin + grain);
+
+            push(c % queues.size(), [&, begin, end](unsigned worker) {
+                // the chunk counts from zero on the worker's stats, which are put back after
+                JSON_STATS_ONLY(JsonStats saved = std::exchange(jsonStats(), JsonStats()));
+                std::exception_ptr failed;
+                try {
+                    f(begin, end, worker);
+                } catch (...) {
+                    failed = std::current_exception();
+                }
+                JSON_STATS_ONLY(JsonStats chunk = std::exchange(jsonStats(), saved));
+
+                std::lock_guard<std::mutex> lock(doneMutex);
+                JSON_STATS_ONLY(counted.add(chunk));
+                if (failed && !error) error = failed;
+                if (--remaining == 0) done.notify_all();
+            });
+        }
+
+        std::unique_lock<std::mutex> lock(doneMutex);
+        done.wait(lock, [&] { return remaining == 0; });
+        JSON_STATS_ONLY(jsonStats().add(counted));
+        if (error) std::rethrow_exception(error);
+    }
+
+    // Splits n items into a few chunks per thread.
+    size_t grainFor(size_t n) const { return std::max<size_t>(1, n / (size() * 8)); }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    size_t pending = 0;
+    bool stopping = false;
+
+    void push(size_t q, Task &&task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queues[q]->mutex);
+            queues[q]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            pending++;
+        }
+        wake.notify_one();
+    }
+
+    bool take(unsigned self, Task &task)
+    {
+        for (size_t k = 0; k < queues.size(); k++)
+        {
+            Queue &q = *queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty()) continue;
+
+            if (k == 0) {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+            } else {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void run(unsigned self)
+    {
+        while (1)
+        {
+            {
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wake.wait(lock, [this] { return pending > 0 || stopping; });
+                if (pending == 0) return;
+                pending--;
+            }
+
+            // pending counted one queued task for us; it may sit in any queue
+            Task task;
+            while (!take(self, task)) std::this_thread::yield();
+            task(self);
+        }
+    }
+};
+
+#endif
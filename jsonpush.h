@@ -0,0 +1,392 @@
+#ifndef JSONPUSH_H
+#define JSONPUSH_H
+
+#include "json.h"
+
+//
+// Incremental parser for input that arrives in pieces. feed() takes each
+// chunk as it comes and fires the handler's SAX events for everything
+// complete so far; finish() marks the end of input. Between chunks the
+// parser keeps only its container stack and the bytes of a token cut by
+// a chunk boundary, so memory is bounded by nesting depth and the
+// longest string, not by the document. Nesting is capped at the
+// recursive readers' JsonScanner::maxDepth.
+//
+// The input is a sequence of values with whitespace between each and the
+// next, so one parser can follow a connection carrying many documents.
+// A number at the very end of a chunk can't be told complete until a
+// delimiter or finish().
+//
+template <typename Handler>
+struct JsonPushParser
+{
+    enum class Expect : uint8_t
+    {
+        Value,          // at the top level, after '[' or ',' in an array, after ':'
+        ValueOrEnd,     // just after '['
+        Key,            // after ',' in an object
+        KeyOrEnd,       // just after '{'
+        Colon,
+        CommaOrEnd
+    };
+
+    enum class Token : uint8_t { None, String, Key, Number, Literal };
+
+#ifdef JSON_STATS
+    JsonStatsHandler<Handler> handler;  // counts tokens on the way through
+#else
+    Handler &handler;
+#endif
+    std::vector<JsonType> stack;    // open containers, Array or Object
+    Expect expect = Expect::Value;
+    size_t values = 0;              // top-level values completed
+    bool delimit = false;           // a top-level value just ended, whitespace must follow
+
+    // a token cut by a chunk boundary
+    Token token = Token::None;
+    std::string partial;
+    size_t partialStart = 0;
+    bool escaped = false;
+    std::string_view word;          // the literal being matched
+
+    size_t consumed = 0;            // bytes fed before the current chunk
+    const char *chunk = nullptr;
+    JsonScanner scan{nullptr, 0};   // decodes one token at a time
+
+    explicit JsonPushParser(Handler &_handler) : handler(_handler) {}
+
+    void feed(std::string_view data) { feed(data.data(), data.size()); }
+
+    void feed(const char *data, size_t size)
+    {
+        JSON_STATS_PHASE(Tokenize);
+        JSON_STATS_ONLY(jsonStats().bytesParsed += size);
+        const char *p = data;
+        const char *end = data + size;
+        chunk = data;
+
+        if (token != Token::None) p = resume(p, end);
+
+        while (p != end)
+        {
+            char c = *p;
+            if (JsonScanner::isSpace(c)) {
+                delimit = false;
+                p++;
+                continue;
+            }
+            if (delimit) error(p, "Invalid JSON value separator");
+
+            switch (expect)
+            {
+            case Expect::ValueOrEnd:
+                if (c == ']') {
+                    p++;
+                    close(JsonType::Array);
+                    break;
+                }
+                [[fallthrough]];
+            case Expect::Value:
+                p = value(p, end);
+                break;
+            case Expect::KeyOrEnd:
+                if (c == '}') {
+                    p++;
+                    close(JsonType::Object);
+                    break;
+                }
+                [[fallthrough]];
+            case Expect::Key:
+                if (c != '"') error(p, "Invalid JSON key sequence");
+                p = stringStart(p, end, Token::Key);
+                break;
+            case Expect::Colon:
+                if (c != ':') error(p, "Invalid JSON key sequence");
+                p++;
+                expect = Expect::Value;
+                break;
+            case Expect::CommaOrEnd:
+                p = separator(p);
+                break;
+            }
+        }
+        consumed += size;
+        chunk = nullptr;
+    }
+
+    // Between values: nothing open and no token pending.
+    bool idle() const { return token == Token::None && stack.empty() && expect == Expect::Value; }
+
+    // Ends the input. Throws if it stopped inside a value, or held none.
+    void finish()
+    {
+        JSON_STATS_PHASE(Tokenize);
+        if (token == Token::Number) {
+            number(partial.data(), partial.data() + partial.size(), partialStart);
+        } else if (token == Token::String || token == Token::Key) {
+            error(consumed, "Unterminated JSON string");
+        } else if (token == Token::Literal) {
+            error(partialStart, "Invalid JSON token");
+        }
+        if (!stack.empty() || expect != Expect::Value || values == 0) error(consumed, "Unexpected end of JSON input");
+    }
+
+private:
+    [[noreturn]] void error(size_t offset, const char *what) const
+    {
+        throw std::runtime_error(std::string(what) + " at offset " + std::to_string(offset));
+    }
+
+    [[noreturn]] void error(const char *p, const char *what) const { error(consumed + (p - chunk), what); }
+
+    size_t offset(const char *p) const { return consumed + (p - chunk); }
+
+    void completed()
+    {
+        if (stack.empty()) {
+            values++;
+            delimit = true;
+            expect = Expect::Value;
+        } else {
+            expect = Expect::CommaOrEnd;
+        }
+    }
+
+    void close(JsonType type)
+    {
+        stack.pop_back();
+        if (type == JsonType::Array) handler.onEndArray();
+        else handler.onEndObject();
+        completed();
+    }
+
+    const char *separator(const char *p)
+    {
+        JsonType top = stack.back();
+        if (*p == ',') {
+            expect = top == JsonType::Object ? Expect::Key : Expect::Value;
+        } else if (*p == ']' && top == JsonType::Array) {
+            close(top);
+        } else if (*p == '}' && top == JsonType::Object) {
+            close(top);
+        } else {
+            error(p, top == JsonType::Object ? "Invalid JSON Object" : "Invalid JSON Array");
+        }
+        return p + 1;
+    }
+
+    const char *value(const char *p, const char *end)
+    {
+        if ((*p == '{' || *p == '[') && stack.size() == JsonScanner::maxDepth) error(p, "JSON nesting too deep");
+
+        switch (*p)
+        {
+        case '{':
+            stack.push_back(JsonType::Object);
+            handler.onStartObject();
+            expect = Expect::KeyOrEnd;
+            return p + 1;
+        case '[':
+            stack.push_back(JsonType::Array);
+            handler.onStartArray();
+            expect = Expect::ValueOrEnd;
+            return p + 1;
+        case '"':
+            return stringStart(p, end, Token::String);
+        case 't':
+            word = "true";
+            break;
+        case 'f':
+            word = "false";
+            break;
+        case 'n':
+            word = "null";
+            break;
+        default:
+            if (*p != '-' && !JsonScanner::isDigit(*p)) error(p, "Invalid JSON number");
+            return numberStart(p, end);
+        }
+
+        token = Token::Literal;
+        partial.clear();
+        partialStart = offset(p);
+        return literal(p, end);
+    }
+
+    // Continues a token left open by the previous chunk.
+    const char *resume(const char *p, const char *end)
+    {
+        switch (token)
+        {
+        case Token::String: case Token::Key: return stringRest(p, end);
+        case Token::Number: return numberRest(p, end);
+        default: return literal(p, end);
+        }
+    }
+
+    //
+    // STRING
+    //
+    // Scans for the closing quote, stepping over escapes. A string that
+    // ends in the chunk it started in is decoded in place; otherwise its
+    // bytes collect in partial until the quote arrives.
+    //
+    const char *stringStart(const char *p, const char *end, Token kind)
+    {
+        const char *close = closingQuote(p + 1, end);
+        if (close != end) {
+            emitString(p, close + 1, offset(p), kind);
+            return close + 1;
+        }
+
+        token = kind;
+        partial.assign(p, end - p);
+        partialStart = offset(p);
+        return end;
+    }
+
+    const char *stringRest(const char *p, const char *end)
+    {
+        const char *close = closingQuote(p, end);
+        if (close == end) {
+            partial.append(p, end - p);
+            return end;
+        }
+
+        partial.append(p, close + 1 - p);
+        Token kind = token;
+        token = Token::None;
+        emitString(partial.data(), partial.data() + partial.size(), partialStart, kind);
+        return close + 1;
+    }
+
+    // First unescaped quote in [p, end), or end; escaped carries a
+    // trailing backslash over to the next chunk.
+    const char *closingQuote(const char *p, const char *end)
+    {
+        for (; p != end; p++)
+        {
+            if (escaped) {
+                escaped = false;
+            } else if (*p == '\\') {
+                escaped = true;
+            } else if (*p == '"') {
+                return p;
+            }
+        }
+        return end;
+    }
+
+    void emitString(const char *begin, const char *end, size_t at, Token kind)
+    {
+        reset(begin, end, at);
+        std::string_view s = scan.parseString();
+        if (kind == Token::Key) {
+            handler.onKey(s);
+            expect = Expect::Colon;
+        } else {
+            handler.onString(s);
+            completed();
+        }
+    }
+
+    //
+    // NUMBER
+    //
+    static bool isNumberChar(char c)
+    {
+        return JsonScanner::isDigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+    }
+
+    const char *numberStart(const char *p, const char *end)
+    {
+        const char *stop = p;
+        while (stop != end && isNumberChar(*stop)) stop++;
+
+        if (stop != end) {
+            number(p, stop, offset(p));
+            return stop;
+        }
+
+        token = Token::Number;
+        partial.assign(p, end - p);
+        partialStart = offset(p);
+        return end;
+    }
+
+    const char *numberRest(const char *p, const char *end)
+    {
+        const char *stop = p;
+        while (stop != end && isNumberChar(*stop)) stop++;
+        partial.append(p, stop - p);
+
+        if (stop != end) {
+            token = Token::None;
+            number(partial.data(), partial.data() + partial.size(), partialStart);
+        }
+        return stop;
+    }
+
+    void number(const char *begin, const char *end, size_t at)
+    {
+        token = Token::None;
+        reset(begin, end, at);
+        scan.parseNumber(handler);
+        completed();
+    }
+
+    //
+    // LITERAL
+    //
+    const char *literal(const char *p, const char *end)
+    {
+        size_t want = word.size() - partial.size();
+        size_t have = std::min<size_t>(want, end - p);
+        partial.append(p, have);
+
+        if (partial.compare(0, partial.size(), word, 0, partial.size()) != 0) error(partialStart, "Invalid JSON token");
+        if (have < want) return end;
+
+        token = Token::None;
+        if (word[0] == 'n') handler.onNull();
+        else handler.onBool(word[0] == 't');
+        completed();
+        return p + have;
+    }
+
+    void reset(const char *begin, const char *end, size_t at)
+    {
+        scan.begin = scan.p = begin;
+        scan.end = end;
+        scan.base = at;
+    }
+};
+
+//
+// Handler for JsonPushParser that builds each top-level value as a DOM
+// and passes it to f(JsonValue &&) as soon as it closes.
+//
+template <typename F>
+struct JsonPushBuilder : public JsonDomBuilder
+{
+    F f;
+
+    explicit JsonPushBuilder(F _f, std::pmr::memory_resource *_mr = std::pmr::get_default_resource(), JsonKeyPool *_keys = nullptr)
+        : JsonDomBuilder(_mr, _keys), f(std::move(_f)) {}
+
+    void done()
+    {
+        if (stack.empty()) f(std::move(root));
+    }
+
+    void onEndObject() { JsonDomBuilder::onEndObject(); done(); }
+    void onEndArray() { JsonDomBuilder::onEndArray(); done(); }
+    void onString(std::string_view s) { JsonDomBuilder::onString(s); done(); }
+    void onInt(int64_t v) { JsonDomBuilder::onInt(v); done(); }
+    void onUint(uint64_t v) { JsonDomBuilder::onUint(v); done(); }
+    void onDouble(double v) { JsonDomBuilder::onDouble(v); done(); }
+    void onBool(bool v) { JsonDomBuilder::onBool(v); done(); }
+    void onNull() { JsonDomBuilder::onNull(); done(); }
+};
+
+#endif
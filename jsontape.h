@@ -0,0 +1,375 @@
+#ifndef JSONTAPE_H
+#define JSONTAPE_H
+
+#include <cstring>
+
+#include "json.h"
+
+//
+// Flat, read-only document. A parse fills one array of 64-bit entries,
+// each an 8-bit tag and a 56-bit payload, plus one buffer of string
+// bytes. Values appear in document order, object members as a key entry
+// followed by the value:
+//
+//   n t f           null, true, false
+//   l u d           int, uint, double; the next entry holds the raw bits
+//   "               string: payload is an offset into the string buffer,
+//                   which holds a 32-bit length and the bytes
+//   [ {             start: low 32 bits index one past the matching end,
+//                   high 24 bits the element count (saturated)
+//   ] }             end: index of the matching start
+//
+// Walking the tape is sequential, skipping a subtree is one load, and
+// reparsing into the same JsonTape reuses both buffers, along with the
+// parse's container stack and string scratch. Once they have grown to
+// fit, a JsonReader parse allocates nothing; the index reader still
+// builds a fresh index each time.
+//
+enum class JsonTapeTag : uint8_t
+{
+    Null = 'n',
+    True = 't',
+    False = 'f',
+    Int = 'l',
+    Uint = 'u',
+    Float = 'd',
+    String = '"',
+    StartArray = '[',
+    EndArray = ']',
+    StartObject = '{',
+    EndObject = '}'
+};
+
+struct JsonTapeRef;
+
+struct JsonTape
+{
+    static constexpr uint64_t payloadMask = (1ULL << 56) - 1;
+    static constexpr uint32_t maxCount = 0xFFFFFF;
+
+    std::vector<uint64_t> tape;
+    std::string strings;
+
+    // parse() state, kept for its capacity
+    std::vector<std::pair<uint32_t, uint32_t>> open;   // start index and count of each open container
+    std::string scratch;                                // lent to the reader for unescaped strings
+
+    template <template <typename> class Reader = JsonReader>
+    void parse(std::string_view json);
+
+    JsonTapeRef root() const;
+
+    JsonTapeTag tag(uint32_t n) const { return (JsonTapeTag)(tape[n] >> 56); }
+    uint64_t payload(uint32_t n) const { return tape[n] & payloadMask; }
+
+    // Index just past the value starting at n.
+    uint32_t next(uint32_t n) const
+    {
+        switch (tag(n))
+        {
+        case JsonTapeTag::StartArray: case JsonTapeTag::StartObject: return (uint32_t)payload(n);
+        case JsonTapeTag::Int: case JsonTapeTag::Uint: case JsonTapeTag::Float: return n + 2;
+        default: return n + 1;
+        }
+    }
+
+    std::string_view string(uint32_t n) const
+    {
+        uint32_t len;
+        const char *s = strings.data() + payload(n);
+        memcpy(&len, s, sizeof(len));
+        return std::string_view(s + sizeof(len), len);
+    }
+
+    // Replays the value at n as SAX events.
+    template <typename Handler>
+    uint32_t replay(uint32_t n, Handler &handler) const
+    {
+        switch (tag(n))
+        {
+        case JsonTapeTag::Null: handler.onNull(); return n + 1;
+        case JsonTapeTag::True: handler.onBool(true); return n + 1;
+        case JsonTapeTag::False: handler.onBool(false); return n + 1;
+        case JsonTapeTag::Int: handler.onInt((int64_t)tape[n + 1]); return n + 2;
+        case JsonTapeTag::Uint: handler.onUint(tape[n + 1]); return n + 2;
+        case JsonTapeTag::Float: {
+            double d;
+            memcpy(&d, &tape[n + 1], sizeof(d));
+            handler.onDouble(d);
+            return n + 2;
+        }
+        case JsonTapeTag::String: handler.onString(string(n)); return n + 1;
+        case JsonTapeTag::StartArray:
+            handler.onStartArray();
+            for (n++; tag(n) != JsonTapeTag::EndArray;) n = replay(n, handler);
+            handler.onEndArray();
+            return n + 1;
+        case JsonTapeTag::StartObject:
+            handler.onStartObject();
+            for (n++; tag(n) != JsonTapeTag::EndObject;) {
+                handler.onKey(string(n));
+                n = replay(n + 1, handler);
+            }
+            handler.onEndObject();
+            return n + 1;
+        default:
+            throw std::runtime_error("Invalid JSON tape");
+        }
+    }
+};
+
+//
+// SAX handler appending to a JsonTape. Open containers keep their start
+// index and element count until they close.
+//
+struct JsonTapeBuilder
+{
+    JsonTape &doc;
+    std::vector<std::pair<uint32_t, uint32_t>> &open;
+
+    explicit JsonTapeBuilder(JsonTape &_doc) : doc(_doc), open(_doc.open) {}
+
+    void push(JsonTapeTag tag, uint64_t payload = 0) { doc.tape.push_back(((uint64_t)tag << 56) | payload); }
+
+    void counted()
+    {
+        if (!open.empty() && open.back().second < JsonTape::maxCount) open.back().second++;
+    }
+
+    void start(JsonTapeTag tag)
+    {
+        counted();
+        if (doc.tape.size() >= UINT32_MAX) throw std::runtime_error("JSON input too large for tape");
+        open.push_back({(uint32_t)doc.tape.size(), 0});
+        push(tag);
+    }
+
+    void finish(JsonTapeTag tag)
+    {
+        auto [begin, count] = open.back();
+        open.pop_back();
+        push(tag, begin);
+        doc.tape[begin] |= ((uint64_t)count << 32) | doc.tape.size();
+    }
+
+    void addString(std::string_view s)
+    {
+        uint32_t len = (uint32_t)s.size();
+        push(JsonTapeTag::String, doc.strings.size());
+        doc.strings.append((const char *)&len, sizeof(len));
+        doc.strings.append(s.data(), s.size());
+    }
+
+    void addNumber(JsonTapeTag tag, uint64_t bits)
+    {
+        counted();
+        push(tag);
+        doc.tape.push_back(bits);
+    }
+
+    void onStartObject() { start(JsonTapeTag::StartObject); }
+    void onKey(std::string_view k) { addString(k); }
+    void onEndObject() { finish(JsonTapeTag::EndObject); }
+    void onStartArray() { start(JsonTapeTag::StartArray); }
+    void onEndArray() { finish(JsonTapeTag::EndArray); }
+    void onString(std::string_view s) { counted(); addString(s); }
+    void onInt(int64_t v) { addNumber(JsonTapeTag::Int, (uint64_t)v); }
+    void onUint(uint64_t v) { addNumber(JsonTapeTag::Uint, v); }
+
+    void onDouble(double v)
+    {
+        uint64_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        addNumber(JsonTapeTag::Float, bits);
+    }
+
+    void onBool(bool v)
+    {
+        counted();
+        push(v ? JsonTapeTag::True : JsonTapeTag::False);
+    }
+
+    void onNull()
+    {
+        counted();
+        push(JsonTapeTag::Null);
+    }
+};
+
+template <template <typename> class Reader>
+void JsonTape::parse(std::string_view json)
+{
+    tape.clear();
+    strings.clear();
+    open.clear();
+    // a rough guess; the tape grows if the document is denser than this
+    tape.reserve(json.size() / 4 + 16);
+    strings.reserve(json.size() / 2 + 16);
+
+    JsonTapeBuilder builder(*this);
+    runJsonReader<Reader>(json.data(), json.size(), builder, &scratch);
+}
+
+//
+// A value on a tape: the tape and an index. Cheap to copy; valid while
+// the JsonTape is unchanged.
+//
+struct JsonTapeRef
+{
+    const JsonTape *doc = nullptr;
+    uint32_t n = 0;
+
+    JsonTapeRef() = default;
+    JsonTapeRef(const JsonTape *_doc, uint32_t _n) : doc(_doc), n(_n) {}
+
+    // False for a key or index that isn't there.
+    explicit operator bool() const { return doc != nullptr; }
+
+    JsonTapeTag tag() const { return doc->tag(n); }
+
+    JsonType type() const
+    {
+        switch (tag())
+        {
+        case JsonTapeTag::Null: return JsonType::Null;
+        case JsonTapeTag::True: case JsonTapeTag::False: return JsonType::Bool;
+        case JsonTapeTag::Int: return JsonType::Int;
+        case JsonTapeTag::Uint: return JsonType::Uint;
+        case JsonTapeTag::Float: return JsonType::Float;
+        case JsonTapeTag::String: return JsonType::String;
+        case JsonTapeTag::StartArray: return JsonType::Array;
+        default: return JsonType::Object;
+        }
+    }
+
+    bool isNull() const { return type() == JsonType::Null; }
+    bool isBool() const { return type() == JsonType::Bool; }
+    bool isInt() const { return type() == JsonType::Int; }
+    bool isUint() const { return type() == JsonType::Uint; }
+    bool isFloat() const { return type() == JsonType::Float; }
+    bool isString() const { return type() == JsonType::String; }
+    bool isArray() const { return type() == JsonType::Array; }
+    bool isObject() const { return type() == JsonType::Object; }
+
+    bool asBool() const { check(JsonType::Bool); return tag() == JsonTapeTag::True; }
+    int64_t asInt() const { check(JsonType::Int); return (int64_t)doc->tape[n + 1]; }
+    uint64_t asUint() const { check(JsonType::Uint); return doc->tape[n + 1]; }
+
+    double asFloat() const
+    {
+        check(JsonType::Float);
+        double d;
+        memcpy(&d, &doc->tape[n + 1], sizeof(d));
+        return d;
+    }
+
+    // A view into the tape's string buffer.
+    std::string_view asString() const { check(JsonType::String); return doc->string(n); }
+
+    // Elements of an array, members of an object.
+    size_t size() const
+    {
+        JsonType t = type();
+        if (t != JsonType::Array && t != JsonType::Object) check(JsonType::Array);
+
+        size_t count = (doc->payload(n) >> 32) & JsonTape::maxCount;
+        if (count < JsonTape::maxCount) return count;
+
+        count = 0;
+        for (Iterator it = begin(); it != end(); ++it) count++;
+        return count;
+    }
+
+    // First member named key; missing if there is none.
+    JsonTapeRef operator[](std::string_view key) const
+    {
+        check(JsonType::Object);
+        for (uint32_t k = n + 1, last = containerEnd(); k != last; k = doc->next(k + 1)) {
+            if (doc->string(k) == key) return JsonTapeRef(doc, k + 1);
+        }
+        return JsonTapeRef();
+    }
+
+    JsonTapeRef operator[](size_t index) const
+    {
+        check(JsonType::Array);
+        for (uint32_t k = n + 1, last = containerEnd(); k != last; k = doc->next(k)) {
+            if (index-- == 0) return JsonTapeRef(doc, k);
+        }
+        return JsonTapeRef();
+    }
+
+    // Iterates array elements, or object values with their keys.
+    struct Iterator
+    {
+        const JsonTape *doc;
+        uint32_t k;
+        bool object;
+
+        JsonTapeRef operator*() const { return JsonTapeRef(doc, object ? k + 1 : k); }
+        std::string_view key() const { return doc->string(k); }
+
+        Iterator &operator++()
+        {
+            k = doc->next(object ? k + 1 : k);
+            return *this;
+        }
+
+        bool operator==(const Iterator &other) const { return k == other.k; }
+        bool operator!=(const Iterator &other) const { return k != other.k; }
+    };
+
+    Iterator begin() const { return {doc, container() + 1, isObject()}; }
+    Iterator end() const { return {doc, containerEnd(), isObject()}; }
+
+    // f(key, value) for each object member.
+    template <typename F>
+    void forEachMember(F &&f) const
+    {
+        check(JsonType::Object);
+        for (Iterator it = begin(); it != end(); ++it) f(it.key(), *it);
+    }
+
+    template <typename Handler>
+    void replay(Handler &handler) const { doc->replay(n, handler); }
+
+    // Copies this value, and everything under it, into a DOM.
+    JsonValue get(std::pmr::memory_resource *mr = std::pmr::get_default_resource(), JsonKeyPool *keys = nullptr) const
+    {
+        JsonDomBuilder builder(mr, keys);
+        replay(builder);
+        return std::move(builder.root);
+    }
+
+private:
+    void check(JsonType t) const
+    {
+        JsonType actual = type();
+        if (actual != t) throw std::runtime_error(std::string("Invalid JSON type: ") + jsonTypeName(actual));
+    }
+
+    uint32_t container() const
+    {
+        JsonType t = type();
+        if (t != JsonType::Array && t != JsonType::Object) check(JsonType::Array);
+        return n;
+    }
+
+    // index of the matching end entry
+    uint32_t containerEnd() const { return doc->next(container()) - 1; }
+};
+
+inline JsonTapeRef JsonTape::root() const
+{
+    if (tape.empty()) throw std::runtime_error("Empty JSON tape");
+    return JsonTapeRef(this, 0);
+}
+
+inline JsonTape parseJsonTape(std::string_view json)
+{
+    JsonTape doc;
+    doc.parse(json);
+    return doc;
+}
+
+#endif